@@ -5,55 +5,45 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
-#include <execution>
+#include <filesystem>
 #include <functional>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <random>
+#include <string>
+#include <system_error>
 #include <utility>
+#include <vector>
 
 #include "yk/bvh.hpp"
+#include "yk/bvh_cache.hpp"
 #include "yk/camera.hpp"
+#include "yk/checkpoint.hpp"
 #include "yk/color.hpp"
 #include "yk/custom.hpp"
+#include "yk/film.hpp"
 #include "yk/hittables/aarect.hpp"
 #include "yk/hittables/hittable_list.hpp"
 #include "yk/hittables/moving_sphere.hpp"
 #include "yk/hittables/sphere.hpp"
+#include "yk/lbvh.hpp"
+#include "yk/light_list.hpp"
+#include "yk/linear_bvh.hpp"
+#include "yk/material_table.hpp"
 #include "yk/materials/dielectric.hpp"
 #include "yk/materials/diffuse_light.hpp"
 #include "yk/materials/lambertian.hpp"
 #include "yk/materials/metal.hpp"
+#include "yk/noise_bake.hpp"
 #include "yk/random.hpp"
+#include "yk/progressive.hpp"
+#include "yk/renderer.hpp"
 #include "yk/textures/checker_texture.hpp"
 #include "yk/textures/image_texture.hpp"
 #include "yk/textures/noise_texture.hpp"
 #include "yk/textures/solid_texture.hpp"
-
-template <class T, class Gen>
-constexpr yk::color<T> ray_color(const yk::ray<T>& r,
-                                 const yk::color<T>& background,
-                                 const yk::hittable<T>& world,
-                                 unsigned int depth, Gen& gen,
-                                 yk::color<T> a = {1, 1, 1},
-                                 yk::color<T> b = {0, 0, 0}) noexcept {
-  if (depth == 0) return {0, 0, 0};
-  yk::hit_record<T> rec{};
-  if (!yk::custom::hit(world, r, 0.001, std::numeric_limits<T>::infinity(),
-                       rec))
-    return a * background + b;
-
-  yk::ray<T> scattered;
-  yk::color<T> attenuation;
-  yk::color<T> emitted = yk::custom::emitted(rec.mat, rec.u, rec.v, rec.pos);
-
-  if (!yk::custom::scatter(rec.mat, r, rec, attenuation, scattered, gen))
-    return a * emitted + b;
-
-  return ray_color(scattered, background, world, depth - 1, gen,
-                   a * attenuation, attenuation * b + emitted);
-}
+#include "yk/wide_bvh.hpp"
 
 template <class T>
 constexpr yk::color<std::uint8_t> into(const yk::color<T>& c) {
@@ -67,13 +57,31 @@ constexpr yk::color<std::uint8_t> into(const yk::color<T>& c) {
   };
 }
 
+// Writes the film as an 8-bit PNG. The image goes to a temporary file that
+// then replaces `path`, so an interrupted write never leaves a broken image.
+template <class T>
+bool write_image(const std::string& path, const yk::film<T>& film) {
+  std::vector<yk::color<std::uint8_t>> img(film.size());
+  for (std::size_t i = 0; i < film.size(); ++i) img[i] = into(film.value(i));
+
+  auto tmp = path + ".tmp";
+  if (!stbi_write_png(tmp.c_str(), int(film.width), int(film.height), 3,
+                      img.data(), int(sizeof(img[0]) * film.width)))
+    return false;
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
 template <class T, class Gen>
-constexpr yk::hittable<T> random_scene(Gen& gen) noexcept {
+constexpr yk::hittable<T> random_scene(yk::material_table<T>& materials,
+                                       Gen& gen) noexcept {
   yk::hittable_list<T> world;
 
   auto checker = yk::checker_texture<T>(yk::solid_texture<T>{{0.2, 0.3, 0.1}},
                                         yk::solid_texture<T>{{0.9, 0.9, 0.9}});
-  world.add(yk::sphere<T>{{0, -1000, 0}, 1000, yk::lambertian<T>{checker}});
+  world.add(yk::sphere<T>{{0, -1000, 0}, 1000,
+                          materials.add(yk::lambertian<T>{checker})});
 
   yk::uniform_real_distribution<T> dist(0, 1);
 
@@ -89,85 +97,107 @@ constexpr yk::hittable<T> random_scene(Gen& gen) noexcept {
         auto center2 = center + yk::vec3<T>{0, dist(gen) / 2, 0};
         world.add(yk::moving_sphere<T>{
             center, center2, 0, 1, 0.2,
-            yk::lambertian<T>{yk::solid_texture<T>{albedo}}});
+            materials.add(yk::lambertian<T>{yk::solid_texture<T>{albedo}})});
       } else if (choose_mat < 0.95) {
         // metal
         auto albedo = yk::color<T>::random(0.5, 1, gen);
         auto fuzz = dist(gen) / 2;
-        world.add(yk::sphere<T>{center, 0.2, yk::metal<T>{albedo, fuzz}});
+        world.add(yk::sphere<T>{center, 0.2,
+                                materials.add(yk::metal<T>{albedo, fuzz})});
       } else {
         // glass
-        world.add(yk::sphere<T>{center, 0.2, yk::dielectric<T>{1.5}});
+        world.add(
+            yk::sphere<T>{center, 0.2, materials.add(yk::dielectric<T>{1.5})});
       }
     }
   }
 
-  world.add(yk::sphere<T>{{0, 1, 0}, 1.0, yk::dielectric<T>(1.5)});
-
   world.add(
-      yk::sphere<T>{{-4, 1, 0},
-                    1.0,
-                    yk::lambertian<T>{yk::solid_texture<T>{{0.4, 0.2, 0.1}}}});
-
-  world.add(yk::sphere<T>{{4, 1, 0}, 1.0, yk::metal<T>({0.7, 0.6, 0.5}, 0.0)});
-
-  return yk::bvh_node<T>(std::move(world), 0, 1, gen);
+      yk::sphere<T>{{0, 1, 0}, 1.0, materials.add(yk::dielectric<T>(1.5))});
+
+  world.add(yk::sphere<T>{
+      {-4, 1, 0},
+      1.0,
+      materials.add(
+          yk::lambertian<T>{yk::solid_texture<T>{{0.4, 0.2, 0.1}}})});
+
+  world.add(yk::sphere<T>{{4, 1, 0},
+                          1.0,
+                          materials.add(yk::metal<T>({0.7, 0.6, 0.5}, 0.0))});
+
+  // The cached build draws one number from `gen`; the preview build draws it
+  // too, so both see the same random numbers afterwards.
+  if (yk::lbvh) {
+    gen();
+    return yk::bvh4<T>(yk::make_lbvh(std::move(world), T(0), T(1)));
+  }
+  return yk::bvh4<T>(yk::cached_linear_bvh<T>("random_scene.bvh",
+                                              std::move(world), 0, 1, gen));
 }
 
 template <class T>
-constexpr auto two_spheres() noexcept {
+constexpr auto two_spheres(yk::material_table<T>& materials) noexcept {
   yk::hittable_list<T> objects;
 
   auto checker = yk::checker_texture<T>(yk::solid_texture<T>{{0.2, 0.3, 0.1}},
                                         yk::solid_texture<T>{{0.9, 0.9, 0.9}});
+  auto mat = materials.add(yk::lambertian<T>{checker});
 
-  objects.add(yk::sphere<T>{{0, -10, 0}, 10, yk::lambertian<T>{checker}});
-  objects.add(yk::sphere<T>{{0, 10, 0}, 10, yk::lambertian<T>{checker}});
+  objects.add(yk::sphere<T>{{0, -10, 0}, 10, mat});
+  objects.add(yk::sphere<T>{{0, 10, 0}, 10, mat});
 
   return objects;
 }
 
 template <class T, class Gen>
-constexpr auto two_perlin_spheres(Gen& gen) noexcept {
+constexpr auto two_perlin_spheres(yk::material_table<T>& materials,
+                                  Gen& gen) noexcept {
   yk::hittable_list<T> objects;
 
-  auto pertext = yk::noise_texture<T>{{gen}, 4};
-  objects.add(yk::sphere<T>{{0, -1000, 0}, 1000, yk::lambertian<T>{pertext}});
-  objects.add(yk::sphere<T>{{0, 2, 0}, 2, yk::lambertian<T>{pertext}});
+  auto pertext = yk::noise_texture<T>{materials.noises.add(gen), 4};
+  auto mat = materials.add(yk::lambertian<T>{pertext});
+  objects.add(yk::sphere<T>{{0, -1000, 0}, 1000, mat});
+  objects.add(yk::sphere<T>{{0, 2, 0}, 2, mat});
 
   return objects;
 }
 
 template <class T>
-auto earth() {
+auto earth(yk::material_table<T>& materials) {
   auto earth_texture = yk::image_texture<T>("earthmap.jpg");
-  auto earth_surface = yk::lambertian<T>{earth_texture};
+  auto earth_surface = materials.add(yk::lambertian<T>{earth_texture});
   auto globe = yk::sphere<T>{{0, 0, 0}, 2, earth_surface};
   return globe;
 }
 
 template <class T, class Gen>
-constexpr auto simple_light(Gen& gen) {
+constexpr auto simple_light(yk::material_table<T>& materials, Gen& gen) {
   yk::hittable_list<T> objects;
 
-  auto pertext = yk::noise_texture<T>{{gen}, 4};
-  objects.add(yk::sphere<T>{{0, -1000, 0}, 1000, yk::lambertian<T>{pertext}});
-  objects.add(yk::sphere<T>{{0, 2, 0}, 2, yk::lambertian<T>{pertext}});
+  auto pertext = yk::noise_texture<T>{materials.noises.add(gen), 4};
+  auto mat = materials.add(yk::lambertian<T>{pertext});
+  objects.add(yk::sphere<T>{{0, -1000, 0}, 1000, mat});
+  objects.add(yk::sphere<T>{{0, 2, 0}, 2, mat});
 
-  auto difflight = yk::diffuse_light<T>{yk::solid_texture<T>{{4, 4, 4}}};
+  auto difflight = materials.add(
+      yk::diffuse_light<T>{yk::solid_texture<T>{{4, 4, 4}}});
   objects.add(yk::xy_rect<T>{3, 5, 1, 3, -2, difflight});
 
   return objects;
 }
 
 template <class T>
-constexpr auto cornell_box() {
+constexpr auto cornell_box(yk::material_table<T>& materials) {
   yk::hittable_list<T> objects;
 
-  auto red = yk::lambertian<T>{yk::solid_texture<T>{{.65, .05, .05}}};
-  auto white = yk::lambertian<T>{yk::solid_texture<T>{{.73, .73, .73}}};
-  auto green = yk::lambertian<T>{yk::solid_texture<T>{{.12, .45, .15}}};
-  auto light = yk::diffuse_light<T>{yk::solid_texture<T>{{15, 15, 15}}};
+  auto red =
+      materials.add(yk::lambertian<T>{yk::solid_texture<T>{{.65, .05, .05}}});
+  auto white =
+      materials.add(yk::lambertian<T>{yk::solid_texture<T>{{.73, .73, .73}}});
+  auto green =
+      materials.add(yk::lambertian<T>{yk::solid_texture<T>{{.12, .45, .15}}});
+  auto light = materials.add(
+      yk::diffuse_light<T>{yk::solid_texture<T>{{15, 15, 15}}});
 
   objects.add(yk::yz_rect<T>{0, 555, 0, 555, 555, green});
   objects.add(yk::yz_rect<T>{0, 555, 0, 555, 0, red});
@@ -179,13 +209,17 @@ constexpr auto cornell_box() {
   return objects;
 }
 
+// Renders the scene. With `resume` the film is first restored from the
+// checkpoint at yk::checkpoint_path, when one was written for this scene.
 template <class T>
-constexpr auto render() noexcept {
+auto render(bool resume) {
   auto R = yk::math::cos(yk::math::numbers::pi / 4);
 
-  yk::mt19937 mt(std::random_device{}());
-  yk::uniform_real_distribution<T> dist(0, 1);
+  // Only used to build the scene; every pixel sample draws from its own
+  // philox_sampler stream.
+  yk::mt19937 mt(static_cast<std::uint32_t>(yk::seed));
 
+  yk::material_table<T> materials;
   yk::hittable<T> world;
   yk::pos3<T> lookfrom;
   yk::pos3<T> lookat;
@@ -193,9 +227,10 @@ constexpr auto render() noexcept {
   auto vfov = 40.0;
   auto aperture = 0.0;
 
-  switch (0) {
+  constexpr int scene = 0;
+  switch (scene) {
     case 1:
-      world = random_scene<T>(mt);
+      world = random_scene<T>(materials, mt);
       background = {0.7, 0.8, 1.0};
       lookfrom = {13, 2, 3};
       lookat = {0, 0, 0};
@@ -204,7 +239,7 @@ constexpr auto render() noexcept {
       break;
 
     case 2:
-      world = two_spheres<T>();
+      world = two_spheres<T>(materials);
       background = {0.7, 0.8, 1.0};
       lookfrom = {13, 2, 3};
       lookat = {0, 0, 0};
@@ -212,7 +247,7 @@ constexpr auto render() noexcept {
       break;
 
     case 3:
-      world = two_perlin_spheres<T>(mt);
+      world = two_perlin_spheres<T>(materials, mt);
       background = {0.7, 0.8, 1.0};
       lookfrom = {13, 2, 3};
       lookat = {0, 0, 0};
@@ -220,7 +255,7 @@ constexpr auto render() noexcept {
       break;
 
     case 4:
-      world = earth<T>();
+      world = earth<T>(materials);
       background = {0.7, 0.8, 1.0};
       lookfrom = {13, 2, 3};
       lookat = {0, 0, 0};
@@ -229,7 +264,7 @@ constexpr auto render() noexcept {
 
     default:
     case 5:
-      world = simple_light<T>(mt);
+      world = simple_light<T>(materials, mt);
       yk::samples_per_pixel = 400;
       background = {0, 0, 0};
       lookfrom = {26, 3, 6};
@@ -238,7 +273,7 @@ constexpr auto render() noexcept {
       break;
 
     case 6:
-      world = cornell_box<T>();
+      world = cornell_box<T>(materials);
       yk::aspect_ratio = 1.0;
       yk::image_width = 600;
       yk::samples_per_pixel = 200;
@@ -251,49 +286,114 @@ constexpr auto render() noexcept {
 
   yk::image_height = std::size_t(yk::image_width / yk::aspect_ratio);
 
-  std::vector<yk::color<std::uint8_t>> img(yk::image_width * yk::image_height);
+  // The BVHs are built around the motion over all of [0, 1]; with a shorter
+  // shutter the boxes only need to cover the part the camera sees.
+  if (yk::shutter < 1) yk::custom::refit(world, T(0), T(yk::shutter));
+
+  auto lights = yk::collect_lights(world, materials);
+  if (yk::noise_bake_resolution)
+    yk::bake_noise_textures(world, materials, yk::noise_bake_resolution,
+                            T(yk::noise_bake_max_error), T(0), T(1), mt);
 
   auto dist_to_focus = 10.0;
   yk::vec3<T> vup{0, 1, 0};
   yk::camera<T> cam(lookfrom, lookat, vup, vfov, yk::aspect_ratio, aperture,
-                    dist_to_focus, 0, 1);
-
-  std::vector<std::pair<int, int>> pixels;
-  pixels.reserve(yk::image_height * yk::image_width);
-
-  for (int h = 0; h < yk::image_height; ++h)
-    for (int w = 0; w < yk::image_width; ++w) pixels.emplace_back(h, w);
-
-  std::for_each(std::execution::par_unseq, pixels.cbegin(), pixels.cend(),
-                [&](const auto& t) {
-                  const auto& [h, w] = t;
-                  // if (w == 0) std::cout << "line : " << h << '\n';
-                  std::vector<yk::ray<T>> rays(yk::samples_per_pixel);
-                  std::generate(rays.begin(), rays.end(), [&, h = h, w = w]() {
-                    auto u = T(w + dist(mt)) / yk::image_width;
-                    auto v =
-                        T(yk::image_height - h - dist(mt)) / yk::image_height;
-                    return cam.get_ray(u, v, mt);
-                  });
-                  yk::color<T> pixel_color =
-                      std::transform_reduce(
-                          std::execution::par_unseq, rays.cbegin(), rays.cend(),
-                          yk::color<T>{0, 0, 0}, std::plus<>{},
-                          [&](const yk::ray<T>& r) {
-                            return ray_color(r, background, world,
-                                             yk::constants::max_depth, mt);
-                          }) *
-                      1.0 / yk::samples_per_pixel;
-                  img[h * yk::image_width + w] = into(pixel_color);
-                });
-
-  return img;
+                    dist_to_focus, 0, yk::shutter);
+
+  // Camera ray through a random point of pixel (w, h).
+  auto camera_ray = [&](std::size_t w, std::size_t h, auto& sampler) {
+    yk::uniform_real_distribution<T> dist(0, 1);
+    auto u = T(w + dist(sampler)) / yk::image_width;
+    auto v = T(yk::image_height - h - dist(sampler)) / yk::image_height;
+    return cam.get_ray(u, v, sampler);
+  };
+
+  yk::film<T> film(yk::image_width, yk::image_height);
+  std::uint32_t spp = yk::samples_per_pixel;
+
+  // A checkpoint only fits the scene and camera it was rendered with.
+  yk::detail::fnv1a key;
+  key.value(scene);
+  for (auto p : {lookfrom, lookat}) {
+    key.value(p.x);
+    key.value(p.y);
+    key.value(p.z);
+  }
+  key.value(vfov);
+  key.value(aperture);
+  key.value(yk::shutter);
+  key.value(background.r);
+  key.value(background.g);
+  key.value(background.b);
+  key.value(yk::noise_bake_resolution);
+  key.value(yk::noise_bake_max_error);
+  key.value(yk::texture_filtering);
+
+  auto checkpoint = [&] {
+    if (*yk::checkpoint_path &&
+        yk::save_checkpoint(yk::checkpoint_path, film, yk::seed, key.state))
+      std::clog << "checkpoint : " << film.total_samples() << " samples\n";
+  };
+  if (resume) {
+    if (yk::load_checkpoint(yk::checkpoint_path, film, yk::seed, key.state))
+      std::clog << "resumed from " << yk::checkpoint_path << " : "
+                << film.total_samples() << " samples\n";
+    else
+      std::clog << "no checkpoint to resume from in " << yk::checkpoint_path
+                << ", starting over\n";
+  }
+  auto budget = std::uint64_t(spp) * film.size();
+
+  // Uniform sampling in passes of pass_spp samples; adaptive sampling starts
+  // with adaptive_min_spp samples everywhere and then keeps adding batches to
+  // the noisiest pixels within the same total budget as a uniform render.
+  auto plan = [&](std::vector<std::uint32_t>& extra) {
+    if (!yk::adaptive)
+      return yk::plan_uniform_pass(film, spp, yk::pass_spp, extra);
+    return yk::plan_uniform_pass(film, std::min(yk::adaptive_min_spp, spp),
+                                 yk::pass_spp, extra) ||
+           yk::plan_adaptive_pass(film, T(yk::adaptive_threshold),
+                                  yk::adaptive_min_spp, 4 * spp, budget,
+                                  extra);
+  };
+  auto pass = [&](const std::vector<std::uint32_t>& extra) {
+    yk::render_pass(film, extra, yk::seed, camera_ray, background, world,
+                    materials, lights);
+  };
+  auto snapshot = [&](const yk::film<T>& f) {
+    write_image("image.png", f);
+    std::clog << "snapshot : " << f.total_samples() << " samples\n";
+    checkpoint();
+  };
+
+  if (!yk::render_progressive(film, plan, pass, yk::snapshot_interval,
+                              snapshot)) {
+    std::clog << "stopped after " << film.total_samples() << " samples\n";
+    checkpoint();
+    return film;
+  }
+
+  if (yk::adaptive)
+    std::clog << "adaptive sampling : " << film.total_samples() << " of "
+              << budget << " samples\n";
+  // The image is final, so a later --resume has nothing left to continue.
+  std::error_code ec;
+  if (*yk::checkpoint_path) std::filesystem::remove(yk::checkpoint_path, ec);
+  return film;
 }
 
-int main() {
-  auto img = render<double>();
+int main(int argc, char* argv[]) {
+  bool resume = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--resume") {
+      resume = true;
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--resume]" << std::endl;
+      return 1;
+    }
+  }
 
-  if (!stbi_write_png("image.png", yk::image_width, yk::image_height, 3,
-                      img.data(), sizeof(img[0]) * yk::image_width))
+  yk::install_stop_handler();
+  if (!write_image("image.png", render<double>(resume)))
     std::cerr << "error!" << std::endl;
 }
@@ -0,0 +1,112 @@
+// BVHs over spheres of radius 2^i / 4 at x = 2^i, for which the SAH build
+// peels off a sphere every few levels. The flattened trees must stay within
+// the traversal stacks and still find every sphere.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "../yk/bvh.hpp"
+#include "../yk/color.hpp"
+#include "../yk/custom.hpp"
+#include "../yk/hittables/aarect.hpp"
+#include "../yk/hittables/hittable_list.hpp"
+#include "../yk/hittables/moving_sphere.hpp"
+#include "../yk/hittables/sphere.hpp"
+#include "../yk/lbvh.hpp"
+#include "../yk/light_list.hpp"
+#include "../yk/linear_bvh.hpp"
+#include "../yk/material_table.hpp"
+#include "../yk/materials/dielectric.hpp"
+#include "../yk/materials/diffuse_light.hpp"
+#include "../yk/materials/lambertian.hpp"
+#include "../yk/materials/metal.hpp"
+#include "../yk/random.hpp"
+#include "../yk/ray_packet.hpp"
+#include "../yk/textures/checker_texture.hpp"
+#include "../yk/textures/image_texture.hpp"
+#include "../yk/textures/noise_texture.hpp"
+#include "../yk/textures/solid_texture.hpp"
+#include "../yk/wide_bvh.hpp"
+
+using T = double;
+
+// As many doublings as the float node boxes can hold, which skews the tree
+// well past the traversal stack.
+constexpr int first_exponent = -120, last_exponent = 124;
+
+yk::hittable_list<T> skewed_spheres() {
+  yk::hittable_list<T> list;
+  for (int i = first_exponent; i <= last_exponent; ++i)
+    list.add(yk::sphere<T>{{std::ldexp(T(1), i), 0, 0}, std::ldexp(T(1), i - 2),
+                           0});
+  return list;
+}
+
+// Number of interior nodes on the longest path from the root.
+std::size_t interior_depth(const yk::linear_bvh<T>& bvh) {
+  std::vector<std::size_t> depth(bvh.nodes.size(), 0);
+  std::size_t deepest = 0;
+  for (std::size_t i = 0; i < bvh.nodes.size(); ++i) {
+    const auto& node = bvh.nodes[i];
+    if (node.count) continue;
+    deepest = std::max(deepest, depth[i] + 1);
+    depth[i + 1] = depth[node.offset] = depth[i] + 1;
+  }
+  return deepest;
+}
+
+// The ray straight down onto sphere i, which it hits at t = 0.5.
+yk::ray<T> ray_onto(int i) {
+  return {{std::ldexp(T(1), i), std::ldexp(T(1), i - 1), 0},
+          {0, -std::ldexp(T(1), i - 1), 0},
+          0};
+}
+
+bool finds_every_sphere(const yk::hittable<T>& world) {
+  for (int i = first_exponent; i <= last_exponent; ++i) {
+    auto r = ray_onto(i);
+    yk::hit_record<T> rec{};
+    if (!yk::custom::hit(world, r, T(0.001),
+                         std::numeric_limits<T>::infinity(), rec) ||
+        rec.t != T(0.5) || !yk::custom::occluded(world, r, T(0.001), T(2)))
+      return false;
+
+    yk::ray_packet<T, 8> packet;
+    for (int lane = 0; lane < 8; ++lane) packet.push(r);
+    std::array<yk::hit_record<T>, 8> recs{};
+    if (yk::hit_packet(world, packet, T(0.001), recs) != 0xff) return false;
+  }
+  return true;
+}
+
+int main() {
+  bool ok = true;
+  auto check = [&](const char* name, std::size_t depth, bool found) {
+    std::cout << name << ": depth " << depth << '\n';
+    if (depth >= yk::linear_bvh<T>::stack_size || !found) {
+      std::cerr << "FAILED: " << name << '\n';
+      ok = false;
+    }
+  };
+
+  yk::mt19937 gen(0);
+  auto build = [&] {
+    return yk::linear_bvh<T>(skewed_spheres(), 0, 1, gen, yk::bvh_split::sah);
+  };
+  auto sah = build();
+  auto sah_depth = interior_depth(sah);
+  yk::hittable<T> linear = std::move(sah);
+  yk::hittable<T> wide = yk::bvh4<T>(build());
+  check("sah", sah_depth, finds_every_sphere(linear));
+  check("sah bvh4", sah_depth, finds_every_sphere(wide));
+
+  auto lbvh = yk::make_lbvh(skewed_spheres(), T(0), T(1));
+  auto lbvh_depth = interior_depth(lbvh);
+  yk::hittable<T> morton = std::move(lbvh);
+  check("lbvh", lbvh_depth, finds_every_sphere(morton));
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
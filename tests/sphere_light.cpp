@@ -0,0 +1,72 @@
+// Next event estimation towards a sphere light, with and without a sphere in
+// between that is more than one unit away from the shaded point.
+
+#include <cstdlib>
+#include <iostream>
+
+#include "../yk/bvh.hpp"
+#include "../yk/color.hpp"
+#include "../yk/custom.hpp"
+#include "../yk/hittables/aarect.hpp"
+#include "../yk/hittables/hittable_list.hpp"
+#include "../yk/hittables/moving_sphere.hpp"
+#include "../yk/hittables/sphere.hpp"
+#include "../yk/integrator.hpp"
+#include "../yk/light_list.hpp"
+#include "../yk/linear_bvh.hpp"
+#include "../yk/material_table.hpp"
+#include "../yk/materials/dielectric.hpp"
+#include "../yk/materials/diffuse_light.hpp"
+#include "../yk/materials/lambertian.hpp"
+#include "../yk/materials/metal.hpp"
+#include "../yk/random.hpp"
+#include "../yk/sampler.hpp"
+#include "../yk/textures/checker_texture.hpp"
+#include "../yk/textures/image_texture.hpp"
+#include "../yk/textures/noise_texture.hpp"
+#include "../yk/textures/solid_texture.hpp"
+#include "../yk/wide_bvh.hpp"
+
+using T = double;
+
+// Light gathered by `samples` light samples from the origin, facing up.
+T direct_light(bool blocked, int samples) {
+  yk::material_table<T> materials;
+  auto white =
+      materials.add(yk::lambertian<T>{yk::solid_texture<T>{{1, 1, 1}}});
+  auto light =
+      materials.add(yk::diffuse_light<T>{yk::solid_texture<T>{{4, 4, 4}}});
+
+  yk::hittable_list<T> objects;
+  objects.add(yk::sphere<T>{{0, 10, 0}, 1, light});
+  if (blocked) objects.add(yk::sphere<T>{{0, 5, 0}, 2, white});
+  yk::hittable<T> world = std::move(objects);
+  auto lights = yk::collect_lights(world, materials);
+
+  yk::hit_record<T> rec{};
+  rec.pos = {0, 0, 0};
+  rec.normal = {0, 1, 0};
+  rec.front_face = true;
+  const auto& m = std::get<yk::lambertian<T>>(materials[white]);
+
+  T sum = 0;
+  for (int s = 0; s < samples; ++s) {
+    yk::philox_sampler gen(0, 0, s);
+    yk::path_state<T> path;
+    path.r = {{0, 1, 0}, {0, -1, 0}, 0};
+    yk::sample_light(path, rec, m, {1, 1, 1}, world, materials, lights, gen);
+    sum += path.radiance.r;
+  }
+  return sum / samples;
+}
+
+int main() {
+  auto open = direct_light(false, 1024);
+  auto blocked = direct_light(true, 1024);
+  std::cout << "open " << open << ", blocked " << blocked << '\n';
+  if (!(open > 0) || blocked != 0) {
+    std::cerr << "FAILED: a blocked sphere light must add nothing\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
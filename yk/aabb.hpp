@@ -3,6 +3,8 @@
 #ifndef YK_RAYTRACING_AABB_HPP
 #define YK_RAYTRACING_AABB_HPP
 
+#include <algorithm>
+
 #include "pos3.hpp"
 #include "ray.hpp"
 
@@ -15,14 +17,23 @@ struct aabb {
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max) const noexcept {
     for (const auto& p : {&vec3<T>::x, &vec3<T>::y, &vec3<T>::z}) {
-      auto [t0, t1] = std::minmax((minimum - r.origin).*p / r.direction.*p,
-                                  (maximum - r.origin).*p / r.direction.*p);
-      t_min = std::min(t_min, t0);
-      t_max = std::max(t_max, t1);
+      auto [t0, t1] = std::minmax({(minimum - r.origin).*p / r.direction.*p,
+                                   (maximum - r.origin).*p / r.direction.*p});
+      t_min = std::max(t_min, t0);
+      t_max = std::min(t_max, t1);
       if (t_max <= t_min) return false;
     }
     return true;
   }
+
+  constexpr pos3<T> centroid() const noexcept {
+    return minimum + (maximum - minimum) / 2;
+  }
+
+  constexpr T surface_area() const noexcept {
+    auto d = maximum - minimum;
+    return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
 };
 
 template <class T>
@@ -3,74 +3,96 @@
 #ifndef YK_RAYTRACING_BVH_HPP
 #define YK_RAYTRACING_BVH_HPP
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "aabb.hpp"
+#include "config.hpp"
 #include "hit_record.hpp"
 #include "hittable.hpp"
 #include "hittables/hittable_list.hpp"
+#include "parallel.hpp"
+
+#if YK_CONFIG_USE_TBB
+#include <tbb/task_group.h>
+#endif
 
 namespace yk {
 
+enum class bvh_split {
+  random_median,  // split at the median along a random axis
+  sah,            // binned surface area heuristic
+};
+
+namespace detail {
+
+// Primitive being placed into a bvh_node together with its cached bounds.
+template <class T>
+struct bvh_build_item {
+  aabb<T> box;
+  std::unique_ptr<hittable<T>> object;
+};
+
+// splitmix64 finalizer, used to derive per-node seeds that do not depend on
+// the order in which subtrees are built.
+constexpr std::uint64_t mix64(std::uint64_t x) noexcept {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+}  // namespace detail
+
 template <class T>
 struct bvh_node {
+  static constexpr std::size_t sah_bin_count = 16;
+  // Subtrees with fewer primitives than this are built on the current thread.
+  static constexpr std::ptrdiff_t parallel_threshold = 4096;
+
   std::unique_ptr<hittable<T>> left;
   std::unique_ptr<hittable<T>> right;
   aabb<T> box;
 
   template <class Gen>
-  constexpr bvh_node(hittable_list<T>&& list, T time0, T time1, Gen& gen)
+  constexpr bvh_node(hittable_list<T>&& list, T time0, T time1, Gen& gen,
+                     bvh_split split = bvh_split::random_median)
       : bvh_node(std::make_move_iterator(list.objects.begin()),
                  std::make_move_iterator(list.objects.end()), time0, time1,
-                 gen) {}
+                 gen, split) {}
 
+  // Moves the primitives into one array once and then builds every level by
+  // partitioning that array in place. Subtrees are built in parallel, but the
+  // tree only depends on the input and on one value drawn from `gen`.
   template <class Iter, class Gen>
-  constexpr bvh_node(Iter first, Iter last, T time0, T time1, Gen& gen) {
-    auto axis = std::array{&pos3<T>::x, &pos3<T>::y,
-                           &pos3<T>::z}[uniform_int_distribution<>{0, 2}(gen)];
-    auto comp = [&](const std::unique_ptr<hittable<T>>& a,
-                    const std::unique_ptr<hittable<T>>& b) {
-      aabb<T> box_a{};
-      aabb<T> box_b{};
-      if (!(a && custom::bounding_box(*a, time0, time1, box_a)) ||
-          !(b && custom::bounding_box(*b, time0, time1, box_b)))
-        std::cerr << "No bounding box in bvh_node constructor.(comp)\n";
-      return std::invoke(axis, box_a.minimum) <
-             std::invoke(axis, box_b.minimum);
-    };
-
-    auto span = std::distance(first, last);
+  constexpr bvh_node(Iter first, Iter last, T time0, T time1, Gen& gen,
+                     bvh_split split = bvh_split::random_median) {
+    std::vector<detail::bvh_build_item<T>> items(std::distance(first, last));
+    for (auto& item : items) item.object = *first++;
 
-    if (span == 1)
-      left = std::move(*first);
-    else if (span == 2) {
-      left = *first;
-      right = *(first + 1);
-      if (!comp(left, right)) std::swap(left, right);
-    } else {
-      std::vector<std::unique_ptr<hittable<T>>> objects(first, last);
-      std::sort(objects.begin(), objects.end(), comp);
-      auto mid = std::make_move_iterator(objects.begin() + span / 2);
-      left = std::make_unique<hittable<T>>(bvh_node<T>(
-          std::make_move_iterator(objects.begin()), mid, time0, time1, gen));
-      right = std::make_unique<hittable<T>>(bvh_node<T>(
-          mid, std::make_move_iterator(objects.end()), time0, time1, gen));
-    }
+    auto compute_box = [&](detail::bvh_build_item<T>& item) {
+      if (!(item.object &&
+            custom::bounding_box(*item.object, time0, time1, item.box)))
+        std::cerr << "No bounding box in bvh_node constructor.\n";
+    };
+    parallel_for(0, items.size(),
+                 [&](std::size_t i) { compute_box(items[i]); });
 
-    aabb<T> box_left{};
-    if (left && custom::bounding_box(*left, time0, time1, box_left)) {
-      aabb<T> box_right{};
-      if (right) {
-        if (custom::bounding_box(*right, time0, time1, box_right))
-          box = surrounding_box(box_left, box_right);
-        else
-          std::cerr << "No bounding box in bvh_node constructor.\n";
-      } else
-        box = box_left;
-    } else
+    if (items.empty()) {
       std::cerr << "No bounding box in bvh_node constructor.\n";
+      return;
+    }
+    build(items.data(), items.data() + items.size(), split,
+          static_cast<std::uint64_t>(gen()));
   }
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max,
@@ -82,11 +104,178 @@ struct bvh_node {
     return hit_left || hit_right;
   }
 
+  constexpr bool occluded(const ray<T>& r, T t_min, T t_max) const noexcept {
+    return box.hit(r, t_min, t_max) &&
+           ((left && custom::occluded(*left, r, t_min, t_max)) ||
+            (right && custom::occluded(*right, r, t_min, t_max)));
+  }
+
   constexpr bool bounding_box(T time0, T time1,
                               aabb<T>& output_box) const noexcept {
     output_box = box;
     return true;
   }
+
+  // Expected cost of tracing a ray that enters this node's box: every child
+  // subtree is weighted by the chance (surface area ratio) of entering it,
+  // while primitive children are always tested.
+  constexpr T sah_cost(T traversal_cost = 1,
+                       T intersection_cost = 1) const noexcept {
+    auto area = box.surface_area();
+    T cost = traversal_cost;
+    for (const auto& child : {&left, &right}) {
+      if (!*child) continue;
+      if (auto node = std::get_if<bvh_node<T>>(child->get()))
+        cost += (area > 0 ? node->box.surface_area() / area : T(1)) *
+                node->sah_cost(traversal_cost, intersection_cost);
+      else
+        cost += intersection_cost;
+    }
+    return cost;
+  }
+
+ private:
+  using item_type = detail::bvh_build_item<T>;
+
+  constexpr bvh_node() noexcept = default;
+
+  constexpr void build(item_type* first, item_type* last, bvh_split split,
+                       std::uint64_t seed) {
+    box = first->box;
+    for (auto it = first + 1; it != last; ++it)
+      box = surrounding_box(box, it->box);
+
+    constexpr auto axes = std::array{&pos3<T>::x, &pos3<T>::y, &pos3<T>::z};
+    auto axis = axes[detail::mix64(seed) % 3];
+    auto comp = [&](const item_type& a, const item_type& b) {
+      return std::invoke(axis, a.box.minimum) <
+             std::invoke(axis, b.box.minimum);
+    };
+
+    auto span = last - first;
+
+    if (span == 1)
+      left = std::move(first->object);
+    else if (span == 2) {
+      if (!comp(first[0], first[1])) std::swap(first[0], first[1]);
+      left = std::move(first[0].object);
+      right = std::move(first[1].object);
+    } else {
+      auto mid = first + span / 2;
+      if (split == bvh_split::sah)
+        mid = sah_partition(first, last);
+      else
+        std::nth_element(first, mid, last, comp);
+
+      auto build_child = [&](std::unique_ptr<hittable<T>>& child,
+                             item_type* b, item_type* e,
+                             std::uint64_t child_seed) {
+        bvh_node<T> node;
+        node.build(b, e, split, child_seed);
+        child = std::make_unique<hittable<T>>(std::move(node));
+      };
+      auto left_seed = detail::mix64(seed ^ 1);
+      auto right_seed = detail::mix64(seed ^ 2);
+#if YK_CONFIG_USE_TBB
+      if (span >= parallel_threshold) {
+        tbb::task_group group;
+        group.run([&] { build_child(left, first, mid, left_seed); });
+        build_child(right, mid, last, right_seed);
+        group.wait();
+        return;
+      }
+#endif
+      build_child(left, first, mid, left_seed);
+      build_child(right, mid, last, right_seed);
+    }
+  }
+
+  // Bins the centroids along every axis and partitions [first, last) at the
+  // cheapest bin boundary. Falls back to a median split on the widest axis
+  // when all centroids coincide.
+  static constexpr item_type* sah_partition(item_type* first,
+                                            item_type* last) {
+    constexpr auto axes = std::array{&pos3<T>::x, &pos3<T>::y, &pos3<T>::z};
+
+    aabb<T> centroid_bounds{first->box.centroid(), first->box.centroid()};
+    for (auto it = first; it != last; ++it)
+      centroid_bounds = surrounding_box(
+          centroid_bounds, aabb<T>{it->box.centroid(), it->box.centroid()});
+
+    auto bin_of = [&](const pos3<T>& c, auto p) {
+      auto lo = std::invoke(p, centroid_bounds.minimum);
+      auto extent = std::invoke(p, centroid_bounds.maximum) - lo;
+      auto i = static_cast<std::size_t>(
+          sah_bin_count * (std::invoke(p, c) - lo) / extent);
+      return std::min(i, sah_bin_count - 1);
+    };
+
+    auto best_cost = std::numeric_limits<T>::infinity();
+    std::size_t best_axis = 0;
+    std::size_t best_bin = 0;
+
+    for (std::size_t a = 0; a < axes.size(); ++a) {
+      auto p = axes[a];
+      if (!(std::invoke(p, centroid_bounds.maximum) >
+            std::invoke(p, centroid_bounds.minimum)))
+        continue;
+
+      std::array<aabb<T>, sah_bin_count> bin_boxes{};
+      std::array<std::size_t, sah_bin_count> bin_counts{};
+      for (auto it = first; it != last; ++it) {
+        auto i = bin_of(it->box.centroid(), p);
+        bin_boxes[i] =
+            bin_counts[i] ? surrounding_box(bin_boxes[i], it->box) : it->box;
+        ++bin_counts[i];
+      }
+
+      // right_areas[i] / right_counts[i] describe bins [i + 1, bin_count).
+      std::array<T, sah_bin_count> right_areas{};
+      std::array<std::size_t, sah_bin_count> right_counts{};
+      aabb<T> acc{};
+      std::size_t count = 0;
+      for (std::size_t i = sah_bin_count - 1; i > 0; --i) {
+        if (bin_counts[i])
+          acc = count ? surrounding_box(acc, bin_boxes[i]) : bin_boxes[i];
+        count += bin_counts[i];
+        right_areas[i - 1] = acc.surface_area();
+        right_counts[i - 1] = count;
+      }
+
+      acc = {};
+      count = 0;
+      for (std::size_t i = 0; i + 1 < sah_bin_count; ++i) {
+        if (bin_counts[i])
+          acc = count ? surrounding_box(acc, bin_boxes[i]) : bin_boxes[i];
+        count += bin_counts[i];
+        if (count == 0 || right_counts[i] == 0) continue;
+        auto cost =
+            count * acc.surface_area() + right_counts[i] * right_areas[i];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = a;
+          best_bin = i;
+        }
+      }
+    }
+
+    if (best_cost == std::numeric_limits<T>::infinity()) {
+      auto d = centroid_bounds.maximum - centroid_bounds.minimum;
+      auto p = d.x > d.y && d.x > d.z ? &pos3<T>::x
+               : d.y > d.z            ? &pos3<T>::y
+                                      : &pos3<T>::z;
+      auto mid = first + (last - first) / 2;
+      std::nth_element(first, mid, last, [&](const auto& a, const auto& b) {
+        return std::invoke(p, a.box.centroid()) <
+               std::invoke(p, b.box.centroid());
+      });
+      return mid;
+    }
+
+    return std::partition(first, last, [&](const item_type& item) {
+      return bin_of(item.box.centroid(), axes[best_axis]) <= best_bin;
+    });
+  }
 };
 
 }  // namespace yk
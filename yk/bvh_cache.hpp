@@ -0,0 +1,244 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_BVH_CACHE_HPP
+#define YK_RAYTRACING_BVH_CACHE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "custom.hpp"
+#include "hittable.hpp"
+#include "hittables/hittable_list.hpp"
+#include "linear_bvh.hpp"
+
+namespace yk {
+
+namespace detail {
+
+// 64-bit FNV-1a over raw bytes.
+struct fnv1a {
+  std::uint64_t state = 0xcbf29ce484222325ull;
+
+  void bytes(const void* data, std::size_t size) noexcept {
+    auto p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      state ^= p[i];
+      state *= 0x100000001b3ull;
+    }
+  }
+
+  template <class U>
+  void value(const U& x) noexcept {
+    static_assert(std::is_trivially_copyable_v<U>);
+    bytes(&x, sizeof(x));
+  }
+};
+
+// Fixed-size file header; the node array and the primitive order follow it.
+struct bvh_cache_header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t node_size;
+  std::uint64_t scene_hash;
+  std::uint64_t node_count;
+  std::uint64_t primitive_count;
+  std::array<std::uint8_t, 24> reserved;
+};
+static_assert(sizeof(bvh_cache_header) == 64);
+
+inline constexpr std::array<char, 8> bvh_cache_magic{'Y', 'K', 'B', 'V',
+                                                     'H', '\0', '\0', '\0'};
+// Bump whenever linear_bvh_node or the builders change what they produce.
+inline constexpr std::uint32_t bvh_cache_version = 1;
+
+// Whether `nodes` form a tree that linear_bvh can traverse safely over
+// `primitive_count` primitives: leaves stay within the primitives, every
+// other node is the child of exactly one node before it, split axes are
+// valid and no path is deeper than the traversal stack.
+template <class T>
+bool valid_bvh_nodes(const std::vector<linear_bvh_node>& nodes,
+                     std::uint64_t primitive_count) {
+  if (nodes.empty()) return primitive_count == 0;
+  std::vector<std::uint32_t> depth(nodes.size(), 0);
+  std::vector<bool> has_parent(nodes.size());
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    if (i > 0 && !has_parent[i]) return false;
+    const auto& node = nodes[i];
+    if (node.count) {
+      if (std::uint64_t(node.offset) + node.count > primitive_count)
+        return false;
+      continue;
+    }
+    if (node.axis > 2 || depth[i] >= linear_bvh<T>::stack_size ||
+        node.offset <= i + 1 || node.offset >= nodes.size())
+      return false;
+    for (std::size_t child : {i + 1, std::size_t(node.offset)}) {
+      if (has_parent[child]) return false;
+      has_parent[child] = true;
+      depth[child] = depth[i] + 1;
+    }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+// Hash of everything a BVH build over `list` depends on: the type and bounds
+// of every primitive in order. Materials and textures do not affect the tree
+// and are left out.
+template <class T>
+std::uint64_t scene_hash(const hittable_list<T>& list, T time0, T time1) {
+  detail::fnv1a h;
+  h.value(detail::bvh_cache_version);
+  h.value(sizeof(T));
+  h.value(list.objects.size());
+  h.value(time0);
+  h.value(time1);
+  for (const auto& object : list.objects) {
+    aabb<T> box{};
+    custom::bounding_box(*object, time0, time1, box);
+    h.value(object->index());
+    h.value(box.minimum.x);
+    h.value(box.minimum.y);
+    h.value(box.minimum.z);
+    h.value(box.maximum.x);
+    h.value(box.maximum.y);
+    h.value(box.maximum.z);
+  }
+  return h.state;
+}
+
+// Writes the nodes and primitive order of `bvh` to `path`. The file is
+// written next to `path` first and renamed over it, so a reader never sees a
+// partial cache.
+template <class T>
+bool save_bvh_cache(const std::filesystem::path& path,
+                    const linear_bvh<T>& bvh, std::uint64_t hash) {
+  if (bvh.order.size() != bvh.primitives.size()) {
+    std::cerr << "No primitive order to cache in save_bvh_cache.\n";
+    return false;
+  }
+
+  detail::bvh_cache_header header{};
+  header.magic = detail::bvh_cache_magic;
+  header.version = detail::bvh_cache_version;
+  header.node_size = sizeof(linear_bvh_node);
+  header.scene_hash = hash;
+  header.node_count = bvh.nodes.size();
+  header.primitive_count = bvh.order.size();
+
+  auto tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(bvh.nodes.data()),
+              bvh.nodes.size() * sizeof(linear_bvh_node));
+    ofs.write(reinterpret_cast<const char*>(bvh.order.data()),
+              bvh.order.size() * sizeof(std::uint32_t));
+    if (!ofs) {
+      std::cerr << "Failed to write " << tmp << ".\n";
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::cerr << "Failed to write " << path << ": " << ec.message() << '\n';
+    return false;
+  }
+  return true;
+}
+
+// Restores a linear_bvh over `list` from the cache at `path`. Fails, leaving
+// `list` untouched, when the file is missing, was written by another version,
+// does not match `hash` or does not hold a valid tree.
+template <class T>
+bool load_bvh_cache(const std::filesystem::path& path, hittable_list<T>& list,
+                    std::uint64_t hash, linear_bvh<T>& output) {
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  std::ifstream ifs(path, std::ios::binary);
+  if (ec || !ifs) return false;
+
+  detail::bvh_cache_header header;
+  if (size < sizeof(header) ||
+      !ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != detail::bvh_cache_magic ||
+      header.version != detail::bvh_cache_version ||
+      header.node_size != sizeof(linear_bvh_node) ||
+      header.scene_hash != hash ||
+      header.primitive_count != list.objects.size())
+    return false;
+  // The counts come from the file, so check them against its size without
+  // multiplying them first.
+  auto payload = size - sizeof(header);
+  if (header.primitive_count > payload / sizeof(std::uint32_t)) return false;
+  payload -= header.primitive_count * sizeof(std::uint32_t);
+  if (payload % sizeof(linear_bvh_node) ||
+      header.node_count != payload / sizeof(linear_bvh_node))
+    return false;
+
+  linear_bvh<T> result;
+  result.nodes.resize(header.node_count);
+  result.order.resize(header.primitive_count);
+  ifs.read(reinterpret_cast<char*>(result.nodes.data()),
+           result.nodes.size() * sizeof(linear_bvh_node));
+  ifs.read(reinterpret_cast<char*>(result.order.data()),
+           result.order.size() * sizeof(std::uint32_t));
+  if (!ifs || !detail::valid_bvh_nodes<T>(result.nodes, header.primitive_count))
+    return false;
+
+  // Check the order is a permutation before moving anything out of `list`.
+  std::vector<bool> seen(list.objects.size());
+  for (auto i : result.order) {
+    if (i >= seen.size() || seen[i]) return false;
+    seen[i] = true;
+  }
+  result.primitives.reserve(result.order.size());
+  for (auto i : result.order)
+    result.primitives.push_back(std::move(*list.objects[i]));
+  list.objects.clear();
+
+  output = std::move(result);
+  return true;
+}
+
+// Builds a linear_bvh over `list`, or restores it from the cache at `path`
+// when that was written for the same scene. Either way `gen` is advanced the
+// same, so the rest of the program sees identical random numbers.
+template <class T, class Gen>
+linear_bvh<T> cached_linear_bvh(const std::filesystem::path& path,
+                                hittable_list<T>&& list, T time0, T time1,
+                                Gen& gen, bvh_split split = bvh_split::sah) {
+  auto seed = gen();
+  detail::fnv1a h;
+  h.value(scene_hash(list, time0, time1));
+  h.value(seed);
+  h.value(split);
+  h.value(linear_bvh<T>::max_leaf_size);
+
+  linear_bvh<T> result;
+  if (load_bvh_cache(path, list, h.state, result)) return result;
+
+  auto replay = [seed] { return seed; };
+  result = linear_bvh<T>(std::move(list), time0, time1, replay, split);
+  save_bvh_cache(path, result, h.state);
+  return result;
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_BVH_CACHE_HPP
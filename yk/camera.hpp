@@ -3,6 +3,7 @@
 #ifndef YK_RAYTRACING_CAMERA_HPP
 #define YK_RAYTRACING_CAMERA_HPP
 
+#include <algorithm>
 #include <cmath>
 
 #include "config.hpp"
@@ -23,6 +24,9 @@ struct camera {
   vec3<T> w, u, v;
   T lens_radius;
   T time0, time1;
+  // Ray spread of a pixel of an image_height tall image, narrowed as the
+  // pixel's samples already average over it (as pbrt scales differentials).
+  T pixel_spread;
 
   constexpr camera(pos3<T> lookfrom, pos3<T> lookat, vec3<T> vup, T vfov,
                    T aspect_ratio, T aperture, T focus_dist, T t0,
@@ -41,6 +45,10 @@ struct camera {
     vertical = focus_dist * viewport_height * v;
     lower_left = {origin - horizontal / 2 - vertical / 2 - focus_dist * w};
     lens_radius = aperture / 2;
+    auto narrowing =
+        std::max(T(0.125), 1 / math::sqrt(T(samples_per_pixel)));
+    pixel_spread =
+        texture_filtering ? vertical.length() / image_height * narrowing : 0;
   }
 
   template <class U, class Gen>
@@ -49,7 +57,8 @@ struct camera {
     vec3<T> offset = u * rd.x + v * rd.y;
     return ray<T>{origin + offset,
                   lower_left + s * horizontal + t * vertical - origin - offset,
-                  uniform_real_distribution<T>(0, 1)(gen)};
+                  uniform_real_distribution<T>(time0, time1)(gen),
+                  pixel_spread};
   }
 };
 
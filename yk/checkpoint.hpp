@@ -0,0 +1,153 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_CHECKPOINT_HPP
+#define YK_RAYTRACING_CHECKPOINT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "film.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define YK_CHECKPOINT_FSYNC 1
+#endif
+
+namespace yk {
+
+namespace detail {
+
+// Fixed-size file header; the film's sums, counts, means and M2s follow it.
+struct checkpoint_header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t scalar_size;
+  std::uint64_t width;
+  std::uint64_t height;
+  std::uint64_t seed;
+  std::uint64_t scene;
+  std::array<std::uint8_t, 16> reserved;
+};
+static_assert(sizeof(checkpoint_header) == 64);
+
+inline constexpr std::array<char, 8> checkpoint_magic{'Y', 'K', 'C', 'K',
+                                                      'P', 'T', '\0', '\0'};
+// Bump whenever film or the sample streams change.
+inline constexpr std::uint32_t checkpoint_version = 1;
+
+template <class U>
+void write_array(std::ofstream& ofs, const std::vector<U>& v) {
+  ofs.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(U));
+}
+
+template <class U>
+void read_array(std::ifstream& ifs, std::vector<U>& v) {
+  ifs.read(reinterpret_cast<char*>(v.data()), v.size() * sizeof(U));
+}
+
+// Flushes the file or directory at `path` to disk. Does nothing where that
+// is not supported.
+inline bool sync_to_disk(const std::filesystem::path& path) noexcept {
+#ifdef YK_CHECKPOINT_FSYNC
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  auto synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+#else
+  return true;
+#endif
+}
+
+}  // namespace detail
+
+// Writes `f` to `path`. Sample s of pixel p always draws from
+// philox_sampler(seed, p, s), so the per-pixel sample counts are also the
+// positions of the pixels' random streams and nothing else needs saving.
+// `scene` identifies the scene and camera the film belongs to. The file is
+// written next to `path` first, flushed to disk and renamed over it, so a
+// reader never sees a partial checkpoint, not even after a crash.
+template <class T>
+bool save_checkpoint(const std::filesystem::path& path, const film<T>& f,
+                     std::uint64_t seed, std::uint64_t scene) {
+  detail::checkpoint_header header{};
+  header.magic = detail::checkpoint_magic;
+  header.version = detail::checkpoint_version;
+  header.scalar_size = sizeof(T);
+  header.width = f.width;
+  header.height = f.height;
+  header.seed = seed;
+  header.scene = scene;
+
+  auto tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    detail::write_array(ofs, f.sum);
+    detail::write_array(ofs, f.count);
+    detail::write_array(ofs, f.mean);
+    detail::write_array(ofs, f.m2);
+    if (!ofs) {
+      std::cerr << "Failed to write " << tmp << ".\n";
+      return false;
+    }
+  }
+
+  if (!detail::sync_to_disk(tmp)) {
+    std::cerr << "Failed to write " << tmp << ".\n";
+    return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::cerr << "Failed to write " << path << ": " << ec.message() << '\n';
+    return false;
+  }
+  // The rename itself only lasts once the directory is flushed as well.
+  auto dir = path.parent_path();
+  detail::sync_to_disk(dir.empty() ? std::filesystem::path(".") : dir);
+  return true;
+}
+
+// Restores `f` from the checkpoint at `path`. Fails, leaving `f` untouched,
+// when the file is missing or truncated, was written by another version, or
+// belongs to another image size, seed or scene.
+template <class T>
+bool load_checkpoint(const std::filesystem::path& path, film<T>& f,
+                     std::uint64_t seed, std::uint64_t scene) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) return false;
+
+  detail::checkpoint_header header;
+  if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != detail::checkpoint_magic ||
+      header.version != detail::checkpoint_version ||
+      header.scalar_size != sizeof(T) || header.width != f.width ||
+      header.height != f.height || header.seed != seed ||
+      header.scene != scene)
+    return false;
+
+  film<T> result(f.width, f.height);
+  detail::read_array(ifs, result.sum);
+  detail::read_array(ifs, result.count);
+  detail::read_array(ifs, result.mean);
+  detail::read_array(ifs, result.m2);
+  if (!ifs || ifs.peek() != std::ifstream::traits_type::eof()) return false;
+
+  f = std::move(result);
+  return true;
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_CHECKPOINT_HPP
@@ -3,6 +3,9 @@
 #ifndef YK_RAYTRACING_CONFIG_HPP
 #define YK_RAYTRACING_CONFIG_HPP
 
+#include <cstddef>
+#include <cstdint>
+
 #ifndef YK_CONFIG_IMG_WIDTH
 #define YK_CONFIG_IMG_WIDTH 100
 #endif  // !YK_CONFIG_IMG_WIDTH
@@ -11,18 +14,139 @@
 #define YK_CONFIG_SPP 100
 #endif  // !YK_CONFIG_SPP
 
+#ifndef YK_CONFIG_TILE_SIZE
+#define YK_CONFIG_TILE_SIZE 16
+#endif  // !YK_CONFIG_TILE_SIZE
+
+#ifndef YK_CONFIG_WAVEFRONT
+#define YK_CONFIG_WAVEFRONT 0
+#endif  // !YK_CONFIG_WAVEFRONT
+
+#ifndef YK_CONFIG_WAVE_SIZE
+#define YK_CONFIG_WAVE_SIZE (1 << 20)
+#endif  // !YK_CONFIG_WAVE_SIZE
+
+#ifndef YK_CONFIG_RAY_PACKET
+#define YK_CONFIG_RAY_PACKET 8
+#endif  // !YK_CONFIG_RAY_PACKET
+
+#ifndef YK_CONFIG_LBVH
+#define YK_CONFIG_LBVH 0
+#endif  // !YK_CONFIG_LBVH
+
+#ifndef YK_CONFIG_SHUTTER
+#define YK_CONFIG_SHUTTER 1.0
+#endif  // !YK_CONFIG_SHUTTER
+
+#ifndef YK_CONFIG_ADAPTIVE
+#define YK_CONFIG_ADAPTIVE 0
+#endif  // !YK_CONFIG_ADAPTIVE
+
+#ifndef YK_CONFIG_ADAPTIVE_MIN_SPP
+#define YK_CONFIG_ADAPTIVE_MIN_SPP 16
+#endif  // !YK_CONFIG_ADAPTIVE_MIN_SPP
+
+#ifndef YK_CONFIG_ADAPTIVE_THRESHOLD
+#define YK_CONFIG_ADAPTIVE_THRESHOLD 0.02
+#endif  // !YK_CONFIG_ADAPTIVE_THRESHOLD
+
+#ifndef YK_CONFIG_PASS_SPP
+#define YK_CONFIG_PASS_SPP 16
+#endif  // !YK_CONFIG_PASS_SPP
+
+#ifndef YK_CONFIG_SNAPSHOT_INTERVAL
+#define YK_CONFIG_SNAPSHOT_INTERVAL 60.0
+#endif  // !YK_CONFIG_SNAPSHOT_INTERVAL
+
+#ifndef YK_CONFIG_CHECKPOINT
+#define YK_CONFIG_CHECKPOINT "render.ckpt"
+#endif  // !YK_CONFIG_CHECKPOINT
+
+#ifndef YK_CONFIG_NOISE_BAKE
+#define YK_CONFIG_NOISE_BAKE 0
+#endif  // !YK_CONFIG_NOISE_BAKE
+
+#ifndef YK_CONFIG_NOISE_BAKE_MAX_ERROR
+#define YK_CONFIG_NOISE_BAKE_MAX_ERROR 0.01
+#endif  // !YK_CONFIG_NOISE_BAKE_MAX_ERROR
+
+#ifndef YK_CONFIG_TEXTURE_FILTER
+#define YK_CONFIG_TEXTURE_FILTER 1
+#endif  // !YK_CONFIG_TEXTURE_FILTER
+
+#ifndef YK_CONFIG_TEXTURE_TILED
+#define YK_CONFIG_TEXTURE_TILED 0
+#endif  // !YK_CONFIG_TEXTURE_TILED
+
+#ifndef YK_CONFIG_TEXTURE_FLOAT
+#define YK_CONFIG_TEXTURE_FLOAT 0
+#endif  // !YK_CONFIG_TEXTURE_FLOAT
+
+#ifndef YK_CONFIG_SEED
+#define YK_CONFIG_SEED 0
+#endif  // !YK_CONFIG_SEED
+
+#ifndef YK_CONFIG_USE_TBB
+#if __has_include(<tbb/task_group.h>)
+#define YK_CONFIG_USE_TBB 1
+#else
+#define YK_CONFIG_USE_TBB 0
+#endif
+#endif  // !YK_CONFIG_USE_TBB
+
 namespace yk {
 
 namespace constants {
 
 inline constexpr auto focal_length = 1.0;
 inline constexpr auto max_depth = 50u;
+inline constexpr auto roulette_depth = 3u;  // bounces before roulette
+// Camera rays traced together by hit_packet (4, 8 or 16; 1 disables).
+inline constexpr std::size_t ray_packet_size = YK_CONFIG_RAY_PACKET;
 
 }  // namespace constants
 
 inline auto aspect_ratio = 16.0 / 9.0;
 inline std::size_t image_width = YK_CONFIG_IMG_WIDTH;
 inline auto samples_per_pixel = YK_CONFIG_SPP;
+inline std::uint64_t seed = YK_CONFIG_SEED;
+inline std::size_t tile_size = YK_CONFIG_TILE_SIZE;
+// Render with render_wavefront, keeping at most wave_size paths in flight.
+inline bool wavefront = YK_CONFIG_WAVEFRONT;
+inline std::size_t wave_size = YK_CONFIG_WAVE_SIZE;
+// Build the BVH of large scenes with make_lbvh instead of the SAH build: much
+// quicker to build but slower to trace, for previews.
+inline bool lbvh = YK_CONFIG_LBVH;
+// The camera shutter is open over [0, shutter] of the [0, 1] the scenes move
+// in.
+inline double shutter = YK_CONFIG_SHUTTER;
+// Adaptive sampling: every pixel starts with adaptive_min_spp samples and
+// pixels whose relative error is above adaptive_threshold get more, within a
+// budget of samples_per_pixel samples per pixel on average.
+inline bool adaptive = YK_CONFIG_ADAPTIVE;
+inline std::uint32_t adaptive_min_spp = YK_CONFIG_ADAPTIVE_MIN_SPP;
+inline double adaptive_threshold = YK_CONFIG_ADAPTIVE_THRESHOLD;
+// Progressive rendering: samples are added in passes of pass_spp samples per
+// pixel (0 renders everything in one pass) and the image is written every
+// snapshot_interval seconds (0 disables intermediate snapshots).
+inline std::uint32_t pass_spp = YK_CONFIG_PASS_SPP;
+inline double snapshot_interval = YK_CONFIG_SNAPSHOT_INTERVAL;
+// Where the film is saved with every snapshot and when a render is stopped,
+// for --resume to continue from ("" disables checkpoints).
+inline const char* checkpoint_path = YK_CONFIG_CHECKPOINT;
+// Noise textures are baked into grids of noise_bake_resolution cells along
+// each object's longest side (0 evaluates them analytically). Grids with an
+// RMS error above noise_bake_max_error are not used.
+inline std::size_t noise_bake_resolution = YK_CONFIG_NOISE_BAKE;
+inline double noise_bake_max_error = YK_CONFIG_NOISE_BAKE_MAX_ERROR;
+// Camera rays carry the cone of their pixel, and image textures are filtered
+// over its footprint with their mip maps (false point samples them).
+inline bool texture_filtering = YK_CONFIG_TEXTURE_FILTER;
+// Image textures are laid out in tiles rather than scanlines, and keep their
+// texels as floats rather than bytes. Tiles pad texels to 4 channels and
+// have not measured faster than scanlines, so they are off by default.
+inline bool texture_tiled = YK_CONFIG_TEXTURE_TILED;
+inline bool texture_float = YK_CONFIG_TEXTURE_FLOAT;
 inline std::size_t image_height = std::size_t(image_width / aspect_ratio);
 
 }  // namespace yk
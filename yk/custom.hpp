@@ -17,13 +17,6 @@ namespace yk {
 
 namespace custom {
 
-template <class T>
-constexpr bool hit(const hittable<T>& h, const ray<T>& r, T t_min, T t_max,
-                   hit_record<T>& rec) noexcept {
-  return std::visit(
-      [&](const auto& ho) { return ho.hit(r, t_min, t_max, rec); }, h);
-}
-
 template <class T, class Gen>
 constexpr bool scatter(const material<T>& mat, const ray<T>& r,
                        const hit_record<T>& rec, color<T>& attenuation,
@@ -47,8 +40,115 @@ struct has_emitted<
         std::declval<T>(), std::declval<T>(), std::declval<pos3<T>>()))>>
     : std::true_type {};
 
+template <class T, class H, class = void>
+struct has_surface : std::false_type {};
+
+template <class T, class H>
+struct has_surface<T, H,
+                   std::void_t<decltype(std::declval<H>().surface(
+                       std::declval<const ray<T>&>(),
+                       std::declval<hit_record<T>&>()))>> : std::true_type {};
+
+template <class T, class H, class = void>
+struct has_pdf_value : std::false_type {};
+
+template <class T, class H>
+struct has_pdf_value<T, H,
+                     std::void_t<decltype(std::declval<H>().pdf_value(
+                         std::declval<const pos3<T>&>(),
+                         std::declval<const vec3<T>&>()))>> : std::true_type {};
+
+template <class T, class Mat, class = void>
+struct has_scattering_pdf : std::false_type {};
+
+template <class T, class Mat>
+struct has_scattering_pdf<
+    T, Mat,
+    std::void_t<decltype(std::declval<Mat>().scattering_pdf(
+        std::declval<const hit_record<T>&>(),
+        std::declval<const vec3<T>&>()))>> : std::true_type {};
+
+template <class T, class Tex, class = void>
+struct has_filtered_value : std::false_type {};
+
+template <class T, class Tex>
+struct has_filtered_value<
+    T, Tex,
+    std::void_t<decltype(std::declval<Tex>().value(
+        std::declval<T>(), std::declval<T>(), std::declval<pos3<T>>(),
+        std::declval<T>(), std::declval<T>()))>> : std::true_type {};
+
+template <class H, class = void>
+struct has_objects : std::false_type {};
+
+template <class H>
+struct has_objects<H, std::void_t<decltype(std::declval<const H&>().objects)>>
+    : std::true_type {};
+
+template <class H, class = void>
+struct has_children : std::false_type {};
+
+template <class H>
+struct has_children<H, std::void_t<decltype(std::declval<const H&>().left),
+                                   decltype(std::declval<const H&>().right)>>
+    : std::true_type {};
+
+template <class H, class = void>
+struct has_primitives : std::false_type {};
+
+template <class H>
+struct has_primitives<
+    H, std::void_t<decltype(std::declval<const H&>().primitives)>>
+    : std::true_type {};
+
+template <class T, class H, class = void>
+struct has_refit : std::false_type {};
+
+template <class T, class H>
+struct has_refit<T, H,
+                 std::void_t<decltype(std::declval<H&>().refit(
+                     std::declval<T>(), std::declval<T>()))>>
+    : std::true_type {};
+
 }  // namespace detail
 
+// Finds the closest hit in (t_min, t_max) but only fills in rec.t and
+// rec.object; call surface() on the final record for everything else.
+template <class T>
+constexpr bool hit(const hittable<T>& h, const ray<T>& r, T t_min, T t_max,
+                   hit_record<T>& rec) noexcept {
+  return std::visit(
+      [&](const auto& ho) {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(ho)>>;
+        if (!ho.hit(r, t_min, t_max, rec)) return false;
+        if constexpr (detail::has_surface<T, H>::value) rec.object = &h;
+        return true;
+      },
+      h);
+}
+
+// Whether anything is hit in (t_min, t_max). Stops at the first hit found
+// and never fills in a hit_record, for shadow and visibility rays.
+template <class T>
+constexpr bool occluded(const hittable<T>& h, const ray<T>& r, T t_min,
+                        T t_max) noexcept {
+  return std::visit(
+      [&](const auto& ho) { return ho.occluded(r, t_min, t_max); }, h);
+}
+
+// Computes the position, normal, uv (with the extent of the ray's footprint
+// in it) and material of the hit found by hit().
+template <class T>
+constexpr void surface(const ray<T>& r, hit_record<T>& rec) noexcept {
+  rec.du = rec.dv = 0;
+  std::visit(
+      [&](const auto& ho) {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(ho)>>;
+        if constexpr (detail::has_surface<T, H>::value) ho.surface(r, rec);
+      },
+      *rec.object);
+}
+
 template <class T>
 constexpr color<T> emitted(const material<T>& mat, T u, T v,
                            const pos3<T>& p) noexcept {
@@ -63,6 +163,37 @@ constexpr color<T> emitted(const material<T>& mat, T u, T v,
       mat);
 }
 
+// Solid-angle density with which random(h, origin, gen) picks `direction`;
+// 0 for primitives that cannot be sampled.
+template <class T>
+constexpr T pdf_value(const hittable<T>& h, const pos3<T>& origin,
+                      const vec3<T>& direction) noexcept {
+  return std::visit(
+      [&](const auto& ho) -> T {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(ho)>>;
+        if constexpr (detail::has_pdf_value<T, H>::value)
+          return ho.pdf_value(origin, direction);
+        else
+          return 0;
+      },
+      h);
+}
+
+// Direction from `origin` towards a random point of `h`.
+template <class T, class Gen>
+constexpr vec3<T> random(const hittable<T>& h, const pos3<T>& origin,
+                         Gen& gen) noexcept {
+  return std::visit(
+      [&](const auto& ho) -> vec3<T> {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(ho)>>;
+        if constexpr (detail::has_pdf_value<T, H>::value)
+          return ho.random(origin, gen);
+        else
+          return {0, 0, 0};
+      },
+      h);
+}
+
 template <class T>
 constexpr bool bounding_box(const hittable<T>& h, T time0, T time1,
                             aabb<T>& output_box) noexcept {
@@ -71,10 +202,60 @@ constexpr bool bounding_box(const hittable<T>& h, T time0, T time1,
       h);
 }
 
+// Calls f(primitive, concrete) for every primitive below `h`, looking
+// through lists and BVHs, where `primitive` is the hittable holding it and
+// `concrete` its alternative.
+template <class T, class F>
+void for_each_primitive(const hittable<T>& h, F&& f) {
+  std::visit(
+      [&](const auto& ho) {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(ho)>>;
+        if constexpr (detail::has_objects<H>::value) {
+          for (const auto& object : ho.objects) for_each_primitive(*object, f);
+        } else if constexpr (detail::has_children<H>::value) {
+          if (ho.left) for_each_primitive(*ho.left, f);
+          if (ho.right) for_each_primitive(*ho.right, f);
+        } else if constexpr (detail::has_primitives<H>::value) {
+          for (const auto& primitive : ho.primitives)
+            for_each_primitive(primitive, f);
+        } else {
+          f(h, ho);
+        }
+      },
+      h);
+}
+
+// Refits the boxes of `h` to its primitives over [time0, time1] when `h` is
+// a BVH that can be refit; returns false otherwise.
 template <class T>
-constexpr color<T> value(const texture<T>& tex, T u, T v,
-                         const pos3<T>& p) noexcept {
-  return std::visit([&](const auto& t) { return t.value(u, v, p); }, tex);
+bool refit(hittable<T>& h, T time0, T time1) {
+  return std::visit(
+      [&](auto& ho) {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(ho)>>;
+        if constexpr (detail::has_refit<T, H>::value) {
+          ho.refit(time0, time1);
+          return true;
+        } else {
+          return false;
+        }
+      },
+      h);
+}
+
+// The texture at (u, v), averaged over a footprint of du by dv around it by
+// the textures that can filter; the others are point sampled.
+template <class T>
+constexpr color<T> value(const texture<T>& tex, T u, T v, const pos3<T>& p,
+                         T du = 0, T dv = 0) noexcept {
+  return std::visit(
+      [&](const auto& t) {
+        using Tex = std::remove_cv_t<std::remove_reference_t<decltype(t)>>;
+        if constexpr (detail::has_filtered_value<T, Tex>::value)
+          return t.value(u, v, p, du, dv);
+        else
+          return t.value(u, v, p);
+      },
+      tex);
 }
 
 }  // namespace custom
@@ -0,0 +1,144 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_FILM_HPP
+#define YK_RAYTRACING_FILM_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "color.hpp"
+
+namespace yk {
+
+template <class T>
+constexpr T luminance(const color<T>& c) noexcept {
+  return T(0.2126) * c.r + T(0.7152) * c.g + T(0.0722) * c.b;
+}
+
+// Accumulates the samples of every pixel. Besides the sum of the samples it
+// keeps Welford running statistics of their luminance, so the noise left in
+// each pixel can be estimated while rendering.
+template <class T>
+struct film {
+  std::size_t width = 0, height = 0;
+  std::vector<color<T>> sum;         // sum of the samples
+  std::vector<std::uint32_t> count;  // number of samples
+  std::vector<T> mean;               // mean sample luminance
+  std::vector<T> m2;                 // sum of squared luminance deviations
+
+  film() = default;
+
+  film(std::size_t w, std::size_t h)
+      : width(w),
+        height(h),
+        sum(w * h, color<T>{0, 0, 0}),
+        count(w * h),
+        mean(w * h),
+        m2(w * h) {}
+
+  constexpr std::size_t size() const noexcept { return sum.size(); }
+
+  constexpr void add_sample(std::size_t pixel, const color<T>& c) noexcept {
+    sum[pixel] += c;
+    auto n = ++count[pixel];
+    auto x = luminance(c);
+    auto delta = x - mean[pixel];
+    mean[pixel] += delta / n;
+    m2[pixel] += delta * (x - mean[pixel]);
+  }
+
+  // Average of the samples so far.
+  constexpr color<T> value(std::size_t pixel) const noexcept {
+    return count[pixel] ? sum[pixel] / count[pixel] : color<T>{0, 0, 0};
+  }
+
+  // Standard error of the pixel's mean luminance relative to that mean
+  // (floored at 0.01 so that near-black pixels are not driven to zero
+  // noise).
+  T relative_error(std::size_t pixel) const noexcept {
+    auto n = count[pixel];
+    if (n < 2) return std::numeric_limits<T>::infinity();
+    auto variance = m2[pixel] / (n - 1);
+    return std::sqrt(variance / n) / std::max(mean[pixel], T(0.01));
+  }
+
+  std::uint64_t total_samples() const noexcept {
+    std::uint64_t total = 0;
+    for (auto n : count) total += n;
+    return total;
+  }
+};
+
+// Plans the next pass of uniform sampling: every pixel with fewer than `spp`
+// samples is given up to `batch` more (all it needs when `batch` is 0).
+// Writes the per-pixel sample counts to `extra` and returns false when the
+// film already has `spp` samples everywhere.
+template <class T>
+bool plan_uniform_pass(const film<T>& f, std::uint32_t spp,
+                       std::uint32_t batch,
+                       std::vector<std::uint32_t>& extra) {
+  extra.assign(f.size(), 0);
+  bool any = false;
+  for (std::size_t p = 0; p < f.size(); ++p) {
+    if (f.count[p] >= spp) continue;
+    extra[p] = batch ? std::min(batch, spp - f.count[p]) : spp - f.count[p];
+    any = true;
+  }
+  return any;
+}
+
+// Plans the next pass of adaptive sampling: every pixel whose relative error
+// is above `threshold` and that has fewer than `max_spp` samples is given
+// `batch` more, noisiest first, as long as the film stays within `budget`
+// samples in total. A pixel's error is the largest in its 3x3 neighbourhood,
+// since a pixel whose few samples all missed the light reports no variance
+// although its neighbours show it is noisy. Writes the per-pixel sample
+// counts to `extra` and returns false when no pixel gets any.
+template <class T>
+bool plan_adaptive_pass(const film<T>& f, T threshold, std::uint32_t batch,
+                        std::uint32_t max_spp, std::uint64_t budget,
+                        std::vector<std::uint32_t>& extra) {
+  extra.assign(f.size(), 0);
+  auto used = f.total_samples();
+  if (used >= budget) return false;
+
+  std::vector<T> error(f.size());
+  for (std::size_t p = 0; p < f.size(); ++p) error[p] = f.relative_error(p);
+
+  std::vector<std::pair<T, std::uint32_t>> noisy;
+  for (std::size_t y = 0; y < f.height; ++y) {
+    for (std::size_t x = 0; x < f.width; ++x) {
+      auto p = y * f.width + x;
+      if (f.count[p] >= max_spp) continue;
+      T e = 0;
+      for (auto ny = y ? y - 1 : y; ny <= std::min(y + 1, f.height - 1); ++ny)
+        for (auto nx = x ? x - 1 : x; nx <= std::min(x + 1, f.width - 1);
+             ++nx)
+          e = std::max(e, error[ny * f.width + nx]);
+      if (e > threshold) noisy.emplace_back(e, std::uint32_t(p));
+    }
+  }
+  std::sort(noisy.begin(), noisy.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+
+  auto remaining = budget - used;
+  bool any = false;
+  for (const auto& [e, p] : noisy) {
+    auto n = std::min<std::uint64_t>(
+        {batch, max_spp - f.count[p], remaining});
+    if (n == 0) break;
+    extra[p] = static_cast<std::uint32_t>(n);
+    remaining -= n;
+    any = true;
+  }
+  return any;
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_FILM_HPP
@@ -3,7 +3,11 @@
 #ifndef YK_RAYTRACING_HIT_RECORD_HPP
 #define YK_RAYTRACING_HIT_RECORD_HPP
 
+#include <algorithm>
+
+#include "hittable.hpp"
 #include "material.hpp"
+#include "math.hpp"
 #include "ray.hpp"
 #include "vec3.hpp"
 
@@ -13,9 +17,13 @@ template <class T>
 struct hit_record {
   pos3<T> pos;
   vec3<T> normal;
-  material<T> mat;
+  material_id mat;
   T t;
+  // Primitive that reported the closest hit; set by custom::hit.
+  const hittable<T>* object;
   T u, v;
+  // Extent of the ray's footprint in u and v; 0 for point sampling.
+  T du = 0, dv = 0;
   bool front_face;
 
   constexpr void set_face_normal(const ray<T>& r,
@@ -23,6 +31,14 @@ struct hit_record {
     front_face = dot(r.direction, outward_normal) < 0;
     normal = front_face ? outward_normal : -outward_normal;
   }
+
+  // Width of r's cone where it meets the surface, stretched by the angle of
+  // incidence. Call after set_face_normal.
+  constexpr T footprint(const ray<T>& r) const noexcept {
+    if (r.spread == 0) return 0;
+    auto cosine = math::abs(dot(r.direction, normal)) / r.direction.length();
+    return r.spread * t / std::max(cosine, T(0.01));
+  }
 };
 
 }  // namespace yk
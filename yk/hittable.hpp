@@ -3,6 +3,7 @@
 #ifndef YK_RAYTRACING_HITTABLE_HPP
 #define YK_RAYTRACING_HITTABLE_HPP
 
+#include <cstddef>
 #include <variant>
 
 #include "material.hpp"
@@ -32,8 +33,16 @@ template <class T>
 struct yz_rect;
 
 template <class T>
-using hittable = std::variant<sphere<T>, hittable_list<T>, moving_sphere<T>,
-                              bvh_node<T>, xy_rect<T>, xz_rect<T>, yz_rect<T>>;
+struct linear_bvh;
+
+template <class T, std::size_t Width>
+struct wide_bvh;
+
+template <class T>
+using hittable =
+    std::variant<sphere<T>, hittable_list<T>, moving_sphere<T>, bvh_node<T>,
+                 xy_rect<T>, xz_rect<T>, yz_rect<T>, linear_bvh<T>,
+                 wide_bvh<T, 4>, wide_bvh<T, 8>>;
 
 }  // namespace yk
 
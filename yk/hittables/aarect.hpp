@@ -3,11 +3,13 @@
 #ifndef YK_RAYTRACING_AARECT_HPP
 #define YK_RAYTRACING_AARECT_HPP
 
+#include <limits>
 #include <utility>
 
 #include "../aabb.hpp"
 #include "../hit_record.hpp"
 #include "../material.hpp"
+#include "../random.hpp"
 #include "../ray.hpp"
 
 namespace yk {
@@ -15,7 +17,7 @@ namespace yk {
 template <class T>
 struct xy_rect {
   T x0, x1, y0, y1, k;
-  material<T> mat;
+  material_id mat;
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max,
                      hit_record<T>& rec) const noexcept {
@@ -24,14 +26,53 @@ struct xy_rect {
     auto x = r.origin.x + t * r.direction.x;
     auto y = r.origin.y + t * r.direction.y;
     if (x < x0 || x > x1 || y < y0 || y > y1) return false;
-    rec.u = (x - x0) / (x1 - x0);
-    rec.v = (y - y0) / (y1 - y0);
     rec.t = t;
+    return true;
+  }
+
+  constexpr bool occluded(const ray<T>& r, T t_min,
+                          T t_max) const noexcept {
+    auto t = (k - r.origin.z) / r.direction.z;
+    if (t < t_min || t > t_max) return false;
+    auto x = r.origin.x + t * r.direction.x;
+    auto y = r.origin.y + t * r.direction.y;
+    return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+  }
+
+  constexpr void surface(const ray<T>& r, hit_record<T>& rec) const noexcept {
+    rec.pos = r.at(rec.t);
+    rec.u = (rec.pos.x - x0) / (x1 - x0);
+    rec.v = (rec.pos.y - y0) / (y1 - y0);
     vec3<T> outward_normal = {0, 0, 1};
     rec.set_face_normal(r, outward_normal);
+    auto width = rec.footprint(r);
+    rec.du = width / (x1 - x0);
+    rec.dv = width / (y1 - y0);
     rec.mat = mat;
-    rec.pos = r.at(t);
-    return true;
+  }
+
+  // Solid-angle density of random(origin, gen) producing `direction`.
+  constexpr T pdf_value(const pos3<T>& origin,
+                        const vec3<T>& direction) const noexcept {
+    hit_record<T> rec;
+    if (!hit({origin, direction}, T(0.001), std::numeric_limits<T>::infinity(),
+             rec))
+      return 0;
+    auto area = (x1 - x0) * (y1 - y0);
+    auto distance_squared = rec.t * rec.t * direction.length_squared();
+    auto cosine = math::abs(direction.z) / direction.length();
+    return distance_squared / (cosine * area);
+  }
+
+  // Direction from `origin` to a uniformly chosen point of the rectangle.
+  template <class Gen>
+  constexpr vec3<T> random(const pos3<T>& origin, Gen& gen) const noexcept {
+    uniform_real_distribution<T> dx(x0, x1), dy(y0, y1);
+    pos3<T> p;
+    p.x = dx(gen);
+    p.y = dy(gen);
+    p.z = k;
+    return p - origin;
   }
 
   constexpr bool bounding_box(T time0, T time1,
@@ -44,7 +85,7 @@ struct xy_rect {
 template <class T>
 struct xz_rect {
   T x0, x1, z0, z1, k;
-  material<T> mat;
+  material_id mat;
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max,
                      hit_record<T>& rec) const noexcept {
@@ -53,14 +94,53 @@ struct xz_rect {
     auto x = r.origin.x + t * r.direction.x;
     auto z = r.origin.z + t * r.direction.z;
     if (x < x0 || x > x1 || z < z0 || z > z1) return false;
-    rec.u = (x - x0) / (x1 - x0);
-    rec.v = (z - z0) / (z1 - z0);
     rec.t = t;
+    return true;
+  }
+
+  constexpr bool occluded(const ray<T>& r, T t_min,
+                          T t_max) const noexcept {
+    auto t = (k - r.origin.y) / r.direction.y;
+    if (t < t_min || t > t_max) return false;
+    auto x = r.origin.x + t * r.direction.x;
+    auto z = r.origin.z + t * r.direction.z;
+    return x >= x0 && x <= x1 && z >= z0 && z <= z1;
+  }
+
+  constexpr void surface(const ray<T>& r, hit_record<T>& rec) const noexcept {
+    rec.pos = r.at(rec.t);
+    rec.u = (rec.pos.x - x0) / (x1 - x0);
+    rec.v = (rec.pos.z - z0) / (z1 - z0);
     vec3<T> outward_normal = {0, 1, 0};
     rec.set_face_normal(r, outward_normal);
+    auto width = rec.footprint(r);
+    rec.du = width / (x1 - x0);
+    rec.dv = width / (z1 - z0);
     rec.mat = mat;
-    rec.pos = r.at(t);
-    return true;
+  }
+
+  // Solid-angle density of random(origin, gen) producing `direction`.
+  constexpr T pdf_value(const pos3<T>& origin,
+                        const vec3<T>& direction) const noexcept {
+    hit_record<T> rec;
+    if (!hit({origin, direction}, T(0.001), std::numeric_limits<T>::infinity(),
+             rec))
+      return 0;
+    auto area = (x1 - x0) * (z1 - z0);
+    auto distance_squared = rec.t * rec.t * direction.length_squared();
+    auto cosine = math::abs(direction.y) / direction.length();
+    return distance_squared / (cosine * area);
+  }
+
+  // Direction from `origin` to a uniformly chosen point of the rectangle.
+  template <class Gen>
+  constexpr vec3<T> random(const pos3<T>& origin, Gen& gen) const noexcept {
+    uniform_real_distribution<T> dx(x0, x1), dz(z0, z1);
+    pos3<T> p;
+    p.x = dx(gen);
+    p.z = dz(gen);
+    p.y = k;
+    return p - origin;
   }
 
   constexpr bool bounding_box(T time0, T time1,
@@ -73,7 +153,7 @@ struct xz_rect {
 template <class T>
 struct yz_rect {
   T y0, y1, z0, z1, k;
-  material<T> mat;
+  material_id mat;
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max,
                      hit_record<T>& rec) const noexcept {
@@ -82,14 +162,53 @@ struct yz_rect {
     auto y = r.origin.y + t * r.direction.y;
     auto z = r.origin.z + t * r.direction.z;
     if (y < y0 || y > y1 || z < z0 || z > z1) return false;
-    rec.u = (y - y0) / (y1 - y0);
-    rec.v = (z - z0) / (z1 - z0);
     rec.t = t;
+    return true;
+  }
+
+  constexpr bool occluded(const ray<T>& r, T t_min,
+                          T t_max) const noexcept {
+    auto t = (k - r.origin.x) / r.direction.x;
+    if (t < t_min || t > t_max) return false;
+    auto y = r.origin.y + t * r.direction.y;
+    auto z = r.origin.z + t * r.direction.z;
+    return y >= y0 && y <= y1 && z >= z0 && z <= z1;
+  }
+
+  constexpr void surface(const ray<T>& r, hit_record<T>& rec) const noexcept {
+    rec.pos = r.at(rec.t);
+    rec.u = (rec.pos.y - y0) / (y1 - y0);
+    rec.v = (rec.pos.z - z0) / (z1 - z0);
     vec3<T> outward_normal = {1, 0, 0};
     rec.set_face_normal(r, outward_normal);
+    auto width = rec.footprint(r);
+    rec.du = width / (y1 - y0);
+    rec.dv = width / (z1 - z0);
     rec.mat = mat;
-    rec.pos = r.at(t);
-    return true;
+  }
+
+  // Solid-angle density of random(origin, gen) producing `direction`.
+  constexpr T pdf_value(const pos3<T>& origin,
+                        const vec3<T>& direction) const noexcept {
+    hit_record<T> rec;
+    if (!hit({origin, direction}, T(0.001), std::numeric_limits<T>::infinity(),
+             rec))
+      return 0;
+    auto area = (y1 - y0) * (z1 - z0);
+    auto distance_squared = rec.t * rec.t * direction.length_squared();
+    auto cosine = math::abs(direction.x) / direction.length();
+    return distance_squared / (cosine * area);
+  }
+
+  // Direction from `origin` to a uniformly chosen point of the rectangle.
+  template <class Gen>
+  constexpr vec3<T> random(const pos3<T>& origin, Gen& gen) const noexcept {
+    uniform_real_distribution<T> dy(y0, y1), dz(z0, z1);
+    pos3<T> p;
+    p.y = dy(gen);
+    p.z = dz(gen);
+    p.x = k;
+    return p - origin;
   }
 
   constexpr bool bounding_box(T time0, T time1,
@@ -28,21 +28,27 @@ struct hittable_list {
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max,
                      hit_record<T>& rec) const noexcept {
-    hit_record<T> temp_rec{};
     bool hit_anything = false;
     auto closest_so_far = t_max;
 
+    // A primitive only writes `rec` when it reports a closer hit, so there
+    // is no need for a scratch record.
     for (const auto& object : objects) {
-      if (yk::custom::hit(*object, r, t_min, closest_so_far, temp_rec)) {
+      if (yk::custom::hit(*object, r, t_min, closest_so_far, rec)) {
         hit_anything = true;
-        closest_so_far = temp_rec.t;
-        rec = temp_rec;
+        closest_so_far = rec.t;
       }
     }
 
     return hit_anything;
   }
 
+  constexpr bool occluded(const ray<T>& r, T t_min, T t_max) const noexcept {
+    for (const auto& object : objects)
+      if (yk::custom::occluded(*object, r, t_min, t_max)) return true;
+    return false;
+  }
+
   constexpr bool bounding_box(T time0, T time1,
                              aabb<T>& output_box) const noexcept {
     if (objects.empty()) return false;
@@ -14,7 +14,7 @@ struct moving_sphere {
   pos3<T> center0, center1;
   T time0, time1;
   T radius;
-  material<T> mat;
+  material_id mat;
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max,
                      hit_record<T>& rec) const noexcept {
@@ -34,12 +34,30 @@ struct moving_sphere {
     }
 
     rec.t = root;
+    return true;
+  }
+
+  // Whether the sphere is crossed anywhere in [t_min, t_max].
+  constexpr bool occluded(const ray<T>& r, T t_min,
+                          T t_max) const noexcept {
+    vec3<T> oc = r.origin - center(r.time);
+    auto a = r.direction.length_squared();
+    auto half_b = dot(oc, r.direction);
+    auto c = oc.length_squared() - radius * radius;
+
+    auto discriminant = half_b * half_b - a * c;
+    if (discriminant < 0) return false;
+    auto sqrtd = math::sqrt(discriminant);
+    auto t0 = (-half_b - sqrtd) / a;
+    auto t1 = (-half_b + sqrtd) / a;
+    return (t_min <= t0 && t0 <= t_max) || (t_min <= t1 && t1 <= t_max);
+  }
+
+  constexpr void surface(const ray<T>& r, hit_record<T>& rec) const noexcept {
     rec.pos = r.at(rec.t);
     vec3<T> outward_normal = (rec.pos - center(r.time)) / radius;
     rec.set_face_normal(r, outward_normal);
     rec.mat = mat;
-
-    return true;
   }
 
   constexpr bool bounding_box(T time0, T time1,
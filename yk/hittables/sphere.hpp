@@ -3,12 +3,15 @@
 #ifndef YK_RAYTRACING_SPHERE_HPP
 #define YK_RAYTRACING_SPHERE_HPP
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 
 #include "../aabb.hpp"
 #include "../hittable.hpp"
 #include "../material.hpp"
 #include "../pos3.hpp"
+#include "../random.hpp"
 #include "../ray.hpp"
 
 namespace yk {
@@ -17,7 +20,7 @@ template <class T>
 struct sphere {
   pos3<T> center;
   T radius;
-  material<T> mat;
+  material_id mat;
 
   constexpr bool hit(const ray<T>& r, T t_min, T t_max,
                      hit_record<T>& rec) const noexcept {
@@ -37,13 +40,38 @@ struct sphere {
     }
 
     rec.t = root;
+    return true;
+  }
+
+  // Whether the sphere is crossed anywhere in [t_min, t_max].
+  constexpr bool occluded(const ray<T>& r, T t_min,
+                          T t_max) const noexcept {
+    vec3<T> oc = r.origin - center;
+    auto a = r.direction.length_squared();
+    auto half_b = dot(oc, r.direction);
+    auto c = oc.length_squared() - radius * radius;
+
+    auto discriminant = half_b * half_b - a * c;
+    if (discriminant < 0) return false;
+    auto sqrtd = math::sqrt(discriminant);
+    auto t0 = (-half_b - sqrtd) / a;
+    auto t1 = (-half_b + sqrtd) / a;
+    return (t_min <= t0 && t0 <= t_max) || (t_min <= t1 && t1 <= t_max);
+  }
+
+  constexpr void surface(const ray<T>& r, hit_record<T>& rec) const noexcept {
     rec.pos = r.at(rec.t);
     vec3<T> outward_normal = (rec.pos - center) / radius;
     rec.set_face_normal(r, outward_normal);
     get_sphere_uv(outward_normal, rec.u, rec.v);
+    if (auto width = rec.footprint(r); width > 0) {
+      // u runs around a circle of radius r sin(theta), v along half of one.
+      auto sin_theta = math::sqrt(std::max<T>(
+          1 - outward_normal.y * outward_normal.y, T(1e-4)));
+      rec.du = width / (2 * T(math::numbers::pi) * radius * sin_theta);
+      rec.dv = width / (T(math::numbers::pi) * radius);
+    }
     rec.mat = mat;
-
-    return true;
   }
 
   constexpr bool bounding_box(T time0, T time1,
@@ -55,6 +83,50 @@ struct sphere {
     return true;
   }
 
+  // Solid-angle density of random(origin, gen) producing `direction`: uniform
+  // over the cone of directions in which the sphere is seen from `origin`.
+  constexpr T pdf_value(const pos3<T>& origin,
+                        const vec3<T>& direction) const noexcept {
+    hit_record<T> rec;
+    auto distance_squared = (center - origin).length_squared();
+    if (distance_squared <= radius * radius ||
+        !hit({origin, direction}, T(0.001),
+             std::numeric_limits<T>::infinity(), rec))
+      return 0;
+    auto cos_theta_max =
+        math::sqrt(1 - radius * radius / distance_squared);
+    return 1 / (2 * T(math::numbers::pi) * (1 - cos_theta_max));
+  }
+
+  // Direction from `origin` to the near side of the sphere, uniformly chosen
+  // over the cone in which the sphere is seen and reaching it at t = 1.
+  template <class Gen>
+  constexpr vec3<T> random(const pos3<T>& origin, Gen& gen) const noexcept {
+    auto oc = center - origin;
+    auto distance_squared = oc.length_squared();
+    if (distance_squared <= radius * radius) return oc;
+    auto w = oc.normalized();
+
+    uniform_real_distribution<T> dist(0, 1);
+    auto cos_theta_max =
+        math::sqrt(1 - radius * radius / distance_squared);
+    auto z = 1 + dist(gen) * (cos_theta_max - 1);
+    auto phi = 2 * T(math::numbers::pi) * dist(gen);
+    auto r = math::sqrt(1 - z * z);
+
+    // Orthonormal basis around w.
+    auto a = math::abs(w.x) > T(0.9) ? vec3<T>{0, 1, 0} : vec3<T>{1, 0, 0};
+    auto v = cross(w, a).normalized();
+    auto u = cross(w, v);
+    auto direction = r * math::cos(phi) * u + r * math::sin(phi) * v + z * w;
+
+    // Distance to the first intersection along the unit direction.
+    auto half_b = dot(direction, oc);
+    auto discriminant =
+        half_b * half_b - (distance_squared - radius * radius);
+    return (half_b - math::sqrt(std::max<T>(discriminant, 0))) * direction;
+  }
+
   static constexpr void get_sphere_uv(const vec3<T>& p, T& u, T& v) noexcept {
     auto theta = math::acos(-p.y);
     auto phi = math::atan2(-p.z, p.x) + math::numbers::pi;
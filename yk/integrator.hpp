@@ -0,0 +1,195 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_INTEGRATOR_HPP
+#define YK_RAYTRACING_INTEGRATOR_HPP
+
+#include <algorithm>
+#include <limits>
+#include <variant>
+
+#include "color.hpp"
+#include "config.hpp"
+#include "custom.hpp"
+#include "hit_record.hpp"
+#include "hittable.hpp"
+#include "light_list.hpp"
+#include "material_table.hpp"
+#include "random.hpp"
+#include "ray.hpp"
+
+namespace yk {
+
+// Everything carried from one bounce of a path to the next.
+template <class T>
+struct path_state {
+  ray<T> r;
+  color<T> throughput{1, 1, 1};  // product of the attenuations so far
+  color<T> radiance{0, 0, 0};    // light gathered so far
+  unsigned int depth = 0;
+  // Density with which the last bounce chose r.direction; 0 for camera rays
+  // and specular bounces, which next event estimation cannot reproduce.
+  T pdf = 0;
+};
+
+// Russian roulette after `constants::roulette_depth` bounces: the path
+// survives with probability equal to its largest throughput component (at
+// most 0.95) and is reweighted to stay unbiased. Returns false when the path
+// is terminated.
+template <class T, class Gen>
+constexpr bool roulette(path_state<T>& path, Gen& gen) noexcept {
+  if (path.depth < constants::roulette_depth) return true;
+  auto p = std::min<T>(std::max({path.throughput.r, path.throughput.g,
+                                 path.throughput.b}),
+                       0.95);
+  if (!(uniform_real_distribution<T>(0, 1)(gen) < p)) return false;
+  path.throughput /= p;
+  return true;
+}
+
+// Power heuristic weight of a sample drawn with density `a` that another
+// strategy would have drawn with density `b`.
+template <class T>
+constexpr T power_heuristic(T a, T b) noexcept {
+  return a * a / (a * a + b * b);
+}
+
+// Next event estimation: adds the light that reaches `rec` directly from a
+// random point on a random light and scatters off `m` along path.r, weighted
+// by MIS against finding the same light by scattering.
+template <class T, class M, class Gen>
+constexpr void sample_light(path_state<T>& path, const hit_record<T>& rec,
+                            const M& m, const color<T>& attenuation,
+                            const hittable<T>& world,
+                            const material_table<T>& materials,
+                            const light_list<T>& lights, Gen& gen) noexcept {
+  vec3<T> direction;
+  const auto& light = lights.sample(rec.pos, gen, direction);
+  auto scattering_pdf = m.scattering_pdf(rec, direction);
+  auto light_pdf = lights.pdf_value(&light, rec.pos, direction);
+  if (!(scattering_pdf > 0) || !(light_pdf > 0)) return;
+
+  // The light itself tells how far along `direction` it is, so the shadow
+  // ray stops just short of it whatever the length of `direction`.
+  ray<T> shadow{rec.pos, direction, path.r.time};
+  hit_record<T> light_rec{};
+  if (!custom::hit(light, shadow, T(0.001),
+                   std::numeric_limits<T>::infinity(), light_rec))
+    return;
+  if (custom::occluded(world, shadow, T(0.001), light_rec.t * T(0.999)))
+    return;
+
+  custom::surface(shadow, light_rec);
+  auto emitted = custom::emitted(materials[light_rec.mat], light_rec.u,
+                                 light_rec.v, light_rec.pos);
+  path.radiance += path.throughput * attenuation * emitted *
+                   (scattering_pdf / light_pdf *
+                    power_heuristic(light_pdf, scattering_pdf));
+}
+
+// Adds the emission at `rec` and scatters `path` off material `m`, sampling
+// `lights` directly when `m` has a scattering_pdf. Returns false once the
+// path has ended.
+template <class T, class M, class Gen>
+constexpr bool shade(path_state<T>& path, const hit_record<T>& rec,
+                     const M& m, const hittable<T>& world,
+                     const material_table<T>& materials,
+                     const light_list<T>& lights, Gen& gen) noexcept {
+  if constexpr (custom::detail::has_emitted<T, M>::value) {
+    // Lights that the previous bounce could also have sampled directly only
+    // count with their MIS weight.
+    auto weight = T(1);
+    if (path.pdf > 0)
+      weight = power_heuristic(
+          path.pdf,
+          lights.pdf_value(rec.object, path.r.origin, path.r.direction));
+    path.radiance +=
+        path.throughput * m.emitted(rec.u, rec.v, rec.pos) * weight;
+  }
+
+  color<T> attenuation;
+  ray<T> scattered;
+  if (!m.scatter(path.r, rec, attenuation, scattered, gen)) return false;
+
+  if constexpr (custom::detail::has_scattering_pdf<T, M>::value) {
+    if (!lights.empty())
+      sample_light(path, rec, m, attenuation, world, materials, lights, gen);
+    path.pdf = m.scattering_pdf(rec, scattered.direction);
+  } else {
+    path.pdf = 0;
+  }
+
+  path.throughput *= attenuation;
+  path.r = scattered;
+  ++path.depth;
+  return roulette(path, gen);
+}
+
+// Finishes the bounce of `path` whose intersection with the scene is already
+// known: `hit` tells whether path.r hit anything and `rec` is the record
+// filled in by custom::hit. Returns false once the path has ended.
+template <class T, class Gen>
+constexpr bool shade_hit(path_state<T>& path, bool hit, hit_record<T>& rec,
+                         const color<T>& background, const hittable<T>& world,
+                         const material_table<T>& materials,
+                         const light_list<T>& lights, Gen& gen) noexcept {
+  if (!hit) {
+    path.radiance += path.throughput * background;
+    return false;
+  }
+  custom::surface(path.r, rec);
+  return std::visit(
+      [&](const auto& m) {
+        return shade(path, rec, m, world, materials, lights, gen);
+      },
+      materials[rec.mat]);
+}
+
+// Advances `path` by one bounce. Returns false once the path has ended, with
+// its contribution in path.radiance.
+template <class T, class Gen>
+constexpr bool step_path(path_state<T>& path, const color<T>& background,
+                         const hittable<T>& world,
+                         const material_table<T>& materials,
+                         const light_list<T>& lights, Gen& gen) noexcept {
+  hit_record<T> rec{};
+  auto hit = custom::hit(world, path.r, T(0.001),
+                         std::numeric_limits<T>::infinity(), rec);
+  return shade_hit(path, hit, rec, background, world, materials, lights, gen);
+}
+
+// Radiance arriving along `r`, following at most `max_depth` bounces.
+template <class T, class Gen>
+constexpr color<T> trace_path(const ray<T>& r, const color<T>& background,
+                              const hittable<T>& world,
+                              const material_table<T>& materials,
+                              const light_list<T>& lights,
+                              unsigned int max_depth, Gen& gen) noexcept {
+  path_state<T> path{r};
+  while (path.depth < max_depth &&
+         step_path(path, background, world, materials, lights, gen)) {
+  }
+  return path.radiance;
+}
+
+// Same as above for a ray whose first intersection (`hit`, `rec`) has been
+// found already, e.g. by hit_packet.
+template <class T, class Gen>
+constexpr color<T> trace_path(const ray<T>& r, bool hit, hit_record<T>& rec,
+                              const color<T>& background,
+                              const hittable<T>& world,
+                              const material_table<T>& materials,
+                              const light_list<T>& lights,
+                              unsigned int max_depth, Gen& gen) noexcept {
+  path_state<T> path{r};
+  if (max_depth > 0 &&
+      shade_hit(path, hit, rec, background, world, materials, lights, gen)) {
+    while (path.depth < max_depth &&
+           step_path(path, background, world, materials, lights, gen)) {
+    }
+  }
+  return path.radiance;
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_INTEGRATOR_HPP
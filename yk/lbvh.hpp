@@ -0,0 +1,226 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_LBVH_HPP
+#define YK_RAYTRACING_LBVH_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "aabb.hpp"
+#include "custom.hpp"
+#include "hittable.hpp"
+#include "hittables/hittable_list.hpp"
+#include "linear_bvh.hpp"
+#include "parallel.hpp"
+
+namespace yk {
+
+namespace detail {
+
+// Spreads the low bits of x so that two zero bits follow each of them.
+constexpr std::uint32_t expand_bits(std::uint32_t x) noexcept {
+  x &= 0x3ff;
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+constexpr std::uint64_t expand_bits(std::uint64_t x) noexcept {
+  x &= 0x1fffff;
+  x = (x | (x << 32)) & 0x001f00000000ffffull;
+  x = (x | (x << 16)) & 0x001f0000ff0000ffull;
+  x = (x | (x << 8)) & 0x100f00f00f00f00full;
+  x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+  x = (x | (x << 2)) & 0x1249249249249249ull;
+  return x;
+}
+
+// 30-bit (Code = uint32_t) or 63-bit (Code = uint64_t) Morton code of a
+// point given in the unit cube.
+template <class Code, class T>
+constexpr Code morton_code(const pos3<T>& p) noexcept {
+  constexpr auto bits = std::is_same_v<Code, std::uint32_t> ? 10 : 21;
+  constexpr T scale = Code(1) << bits;
+  auto quantize = [&](T x) {
+    return static_cast<Code>(std::clamp<T>(x * scale, 0, scale - 1));
+  };
+  return (expand_bits(quantize(p.x)) << 2) |
+         (expand_bits(quantize(p.y)) << 1) | expand_bits(quantize(p.z));
+}
+
+// Stable LSD radix sort of (code, index) pairs, eight bits per pass. Every
+// pass histograms fixed-size blocks in parallel and scatters them in
+// parallel to offsets given by a prefix sum over (digit, block).
+template <class Code>
+void radix_sort(std::vector<std::pair<Code, std::uint32_t>>& keys) {
+  constexpr std::size_t radix = 256;
+  constexpr std::size_t block_size = 1 << 14;
+  auto n = keys.size();
+  auto blocks = (n + block_size - 1) / block_size;
+  std::vector<std::pair<Code, std::uint32_t>> buffer(n);
+  std::vector<std::array<std::size_t, radix>> offsets(blocks);
+
+  for (unsigned shift = 0; shift < sizeof(Code) * 8; shift += 8) {
+    parallel_for(0, blocks, [&](std::size_t b) {
+      offsets[b].fill(0);
+      auto last = std::min(n, (b + 1) * block_size);
+      for (auto i = b * block_size; i < last; ++i)
+        ++offsets[b][(keys[i].first >> shift) & (radix - 1)];
+    });
+
+    std::size_t sum = 0;
+    bool single_digit = false;
+    for (std::size_t d = 0; d < radix; ++d) {
+      auto digit_start = sum;
+      for (std::size_t b = 0; b < blocks; ++b)
+        sum += std::exchange(offsets[b][d], sum);
+      if (sum - digit_start == n) single_digit = true;
+    }
+    if (single_digit) continue;  // this pass would not reorder anything
+
+    parallel_for(0, blocks, [&](std::size_t b) {
+      auto last = std::min(n, (b + 1) * block_size);
+      for (auto i = b * block_size; i < last; ++i)
+        buffer[offsets[b][(keys[i].first >> shift) & (radix - 1)]++] =
+            keys[i];
+    });
+    keys.swap(buffer);
+  }
+}
+
+}  // namespace detail
+
+// Linear BVH builder for scenes that change every frame. Primitives are
+// sorted along a Morton curve of their centroids and the hierarchy is read
+// off the sorted codes (Karras 2012), so the build is a few linear passes.
+// The tree is worse than bvh_split::sah but is emitted straight into the
+// linear_bvh layout.
+template <class T, class Code = std::uint32_t>
+linear_bvh<T> make_lbvh(hittable_list<T>&& list, T time0, T time1) {
+  static_assert(std::is_same_v<Code, std::uint32_t> ||
+                    std::is_same_v<Code, std::uint64_t>,
+                "Morton codes are 30-bit (uint32_t) or 63-bit (uint64_t)");
+
+  linear_bvh<T> result;
+  auto& objects = list.objects;
+  auto n = objects.size();
+  if (n == 0) return result;
+
+  std::vector<aabb<T>> boxes(n);
+  parallel_for(0, n, [&](std::size_t i) {
+    if (!custom::bounding_box(*objects[i], time0, time1, boxes[i]))
+      std::cerr << "No bounding box in make_lbvh.\n";
+  });
+
+  aabb<T> bounds{boxes.front().centroid(), boxes.front().centroid()};
+  for (const auto& b : boxes)
+    bounds = surrounding_box(bounds, aabb<T>{b.centroid(), b.centroid()});
+  auto extent = bounds.maximum - bounds.minimum;
+  auto normalize = [&](T x, T lo, T e) { return e > 0 ? (x - lo) / e : T(0); };
+
+  std::vector<std::pair<Code, std::uint32_t>> keys(n);
+  parallel_for(0, n, [&](std::size_t i) {
+    auto c = boxes[i].centroid();
+    keys[i] = {detail::morton_code<Code, T>(
+                   {normalize(c.x, bounds.minimum.x, extent.x),
+                    normalize(c.y, bounds.minimum.y, extent.y),
+                    normalize(c.z, bounds.minimum.z, extent.z)}),
+               static_cast<std::uint32_t>(i)};
+  });
+  detail::radix_sort(keys);
+
+  // Length of the common prefix of keys i and j, with the key index breaking
+  // ties between equal codes; -1 when j is out of range.
+  auto delta = [&](std::ptrdiff_t i, std::ptrdiff_t j) -> int {
+    if (j < 0 || j >= static_cast<std::ptrdiff_t>(n)) return -1;
+    auto a = keys[i].first;
+    auto b = keys[j].first;
+    if (a != b) return std::countl_zero(static_cast<Code>(a ^ b));
+    return int(sizeof(Code) * 8) +
+           std::countl_zero(static_cast<std::uint64_t>(i ^ j));
+  };
+
+  // Internal node i splits its key range after split[i]; the range itself
+  // has i at one end. Every internal node is found independently.
+  std::vector<std::uint32_t> split(n);
+  parallel_for(0, n - 1, [&](std::size_t k) {
+    auto i = static_cast<std::ptrdiff_t>(k);
+    auto d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+    auto delta_min = delta(i, i - d);
+
+    std::ptrdiff_t l_max = 2;
+    while (delta(i, i + l_max * d) > delta_min) l_max *= 2;
+    std::ptrdiff_t l = 0;
+    for (auto t = l_max / 2; t >= 1; t /= 2)
+      if (delta(i, i + (l + t) * d) > delta_min) l += t;
+    auto j = i + l * d;
+
+    auto delta_node = delta(i, j);
+    std::ptrdiff_t s = 0;
+    for (auto t = (l + 1) / 2;; t = (t + 1) / 2) {
+      if (delta(i, i + (s + t) * d) > delta_node) s += t;
+      if (t == 1) break;
+    }
+    split[k] = static_cast<std::uint32_t>(i + s * d + std::min(d, 0));
+  });
+
+  result.primitives.reserve(n);
+  result.order.reserve(n);
+  for (const auto& [code, index] : keys) {
+    result.primitives.push_back(std::move(*objects[index]));
+    result.order.push_back(index);
+  }
+
+  // Emits the subtree covering sorted primitives [lo, hi] at `depth` depth
+  // first, whose internal root (if any) is `node`, and returns its bounds.
+  // Like linear_bvh's own builder it stops splitting before the tree gets
+  // deeper than the traversal stack allows.
+  auto emit = [&](auto& self, std::uint32_t node, std::uint32_t lo,
+                  std::uint32_t hi, std::size_t depth) -> aabb<T> {
+    auto index = result.nodes.size();
+    result.nodes.emplace_back();
+
+    if (hi - lo + 1 <= linear_bvh<T>::max_leaf_size ||
+        depth + 1 >= linear_bvh<T>::stack_size) {
+      auto box = boxes[keys[lo].second];
+      for (auto i = lo + 1; i <= hi; ++i)
+        box = surrounding_box(box, boxes[keys[i].second]);
+      result.nodes[index] = {detail::to_float_box(box), lo,
+                             static_cast<std::uint16_t>(hi - lo + 1), 0, 0};
+      return box;
+    }
+
+    // Lay the child on the negative side of the Morton order's most
+    // significant differing axis first.
+    auto bit = std::countl_zero(
+        static_cast<Code>(keys[lo].first ^ keys[hi].first));
+    auto leading = int(sizeof(Code) * 8) - int(sizeof(Code) * 8 / 3) * 3;
+    std::uint8_t axis =
+        bit < int(sizeof(Code) * 8) ? std::uint8_t((bit - leading) % 3) : 0;
+
+    // The children are the leaf or internal node at either side of the split.
+    auto box_first = self(self, split[node], lo, split[node], depth + 1);
+    auto second = static_cast<std::uint32_t>(result.nodes.size());
+    auto box_second =
+        self(self, split[node] + 1, split[node] + 1, hi, depth + 1);
+    auto box = surrounding_box(box_first, box_second);
+    result.nodes[index] = {detail::to_float_box(box), second, 0, axis, 0};
+    return box;
+  };
+  emit(emit, 0, 0, static_cast<std::uint32_t>(n - 1), 0);
+
+  return result;
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_LBVH_HPP
@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_LIGHT_LIST_HPP
+#define YK_RAYTRACING_LIGHT_LIST_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "bvh.hpp"
+#include "custom.hpp"
+#include "hittable.hpp"
+#include "hittables/hittable_list.hpp"
+#include "material_table.hpp"
+#include "pos3.hpp"
+#include "random.hpp"
+#include "vec3.hpp"
+
+namespace yk {
+
+// The emissive primitives of a scene that can be sampled directly, for next
+// event estimation. Holds pointers into the world it was collected from,
+// which must outlive it and stay in place.
+template <class T>
+struct light_list {
+  std::vector<const hittable<T>*> lights;  // sorted by address
+
+  bool empty() const noexcept { return lights.empty(); }
+  std::size_t size() const noexcept { return lights.size(); }
+
+  // Picks a light uniformly and returns it, with the direction from `origin`
+  // to a random point on it in `direction`.
+  template <class Gen>
+  const hittable<T>& sample(const pos3<T>& origin, Gen& gen,
+                            vec3<T>& direction) const noexcept {
+    uniform_real_distribution<T> dist(0, 1);
+    auto i = std::min(static_cast<std::size_t>(dist(gen) * lights.size()),
+                      lights.size() - 1);
+    direction = custom::random(*lights[i], origin, gen);
+    return *lights[i];
+  }
+
+  // Solid-angle density of sample() choosing `direction` towards `light`;
+  // 0 when `light` is not in the list.
+  T pdf_value(const hittable<T>* light, const pos3<T>& origin,
+              const vec3<T>& direction) const noexcept {
+    if (!std::binary_search(lights.begin(), lights.end(), light,
+                            std::less<>{}))
+      return 0;
+    return custom::pdf_value(*light, origin, direction) / lights.size();
+  }
+};
+
+// Collects every sampleable primitive of `world` with an emissive material.
+template <class T>
+light_list<T> collect_lights(const hittable<T>& world,
+                             const material_table<T>& materials) {
+  light_list<T> result;
+  custom::for_each_primitive(
+      world, [&](const hittable<T>& primitive, const auto& concrete) {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(concrete)>>;
+        if constexpr (custom::detail::has_pdf_value<T, H>::value) {
+          bool emissive = std::visit(
+              [](const auto& m) {
+                using M = std::remove_cvref_t<decltype(m)>;
+                return custom::detail::has_emitted<T, M>::value;
+              },
+              materials[concrete.mat]);
+          if (emissive) result.lights.push_back(&primitive);
+        }
+      });
+  std::sort(result.lights.begin(), result.lights.end(), std::less<>{});
+  return result;
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_LIGHT_LIST_HPP
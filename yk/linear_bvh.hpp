@@ -0,0 +1,308 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_LINEAR_BVH_HPP
+#define YK_RAYTRACING_LINEAR_BVH_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "custom.hpp"
+#include "hit_record.hpp"
+#include "hittable.hpp"
+#include "hittables/hittable_list.hpp"
+#include "parallel.hpp"
+#include "ray.hpp"
+
+namespace yk {
+
+// 32-byte node of linear_bvh. Bounds are kept in single precision, rounded
+// outward so that they still enclose the original box.
+struct alignas(32) linear_bvh_node {
+  aabb<float> box;
+  std::uint32_t offset;  // first primitive (leaf) or second child (interior)
+  std::uint16_t count;   // number of primitives, 0 for interior nodes
+  std::uint8_t axis;     // axis along which the first child lies before
+  std::uint8_t pad;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32);
+
+namespace detail {
+
+template <class T>
+constexpr float round_down(T x) noexcept {
+  auto f = static_cast<float>(x);
+  return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+template <class T>
+constexpr float round_up(T x) noexcept {
+  auto f = static_cast<float>(x);
+  return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+template <class T>
+constexpr aabb<float> to_float_box(const aabb<T>& b) noexcept {
+  return {
+      {round_down(b.minimum.x), round_down(b.minimum.y),
+       round_down(b.minimum.z)},
+      {round_up(b.maximum.x), round_up(b.maximum.y), round_up(b.maximum.z)},
+  };
+}
+
+template <class T>
+constexpr aabb<T> from_float_box(const aabb<float>& b) noexcept {
+  return {
+      {b.minimum.x, b.minimum.y, b.minimum.z},
+      {b.maximum.x, b.maximum.y, b.maximum.z},
+  };
+}
+
+// Slab test against a box with the ray's reciprocal direction precomputed.
+template <class T>
+constexpr bool slab_hit(const aabb<float>& b, const pos3<T>& origin,
+                        const vec3<T>& inv_dir, T t_min, T t_max) noexcept {
+  auto tx0 = (b.minimum.x - origin.x) * inv_dir.x;
+  auto tx1 = (b.maximum.x - origin.x) * inv_dir.x;
+  auto ty0 = (b.minimum.y - origin.y) * inv_dir.y;
+  auto ty1 = (b.maximum.y - origin.y) * inv_dir.y;
+  auto tz0 = (b.minimum.z - origin.z) * inv_dir.z;
+  auto tz1 = (b.maximum.z - origin.z) * inv_dir.z;
+  t_min = std::max({t_min, std::min(tx0, tx1), std::min(ty0, ty1),
+                    std::min(tz0, tz1)});
+  t_max = std::min({t_max, std::max(tx0, tx1), std::max(ty0, ty1),
+                    std::max(tz0, tz1)});
+  return t_min <= t_max;
+}
+
+}  // namespace detail
+
+// Pointer-free BVH: nodes are stored depth first in one array, so the first
+// child of an interior node immediately follows it, and leaves refer to a
+// contiguous range of `primitives`.
+template <class T>
+struct linear_bvh {
+  static constexpr std::size_t max_leaf_size = 4;
+  static constexpr std::size_t stack_size = 64;
+  // Subtrees spanning fewer nodes than this are refit on the current thread.
+  static constexpr std::size_t parallel_refit_threshold = 1024;
+
+  std::vector<linear_bvh_node> nodes;
+  std::vector<hittable<T>> primitives;
+  // Index of every primitive in the hittable_list it was built from; empty
+  // when that is unknown.
+  std::vector<std::uint32_t> order;
+
+  constexpr linear_bvh() noexcept = default;
+
+  template <class Gen>
+  linear_bvh(hittable_list<T>&& list, T time0, T time1, Gen& gen,
+             bvh_split split = bvh_split::sah) {
+    // bvh_node only moves the owning pointers around, so the address of
+    // every primitive identifies its position in `list`.
+    std::unordered_map<const hittable<T>*, std::uint32_t> index_of;
+    for (std::size_t i = 0; i < list.objects.size(); ++i)
+      index_of.emplace(list.objects[i].get(), static_cast<std::uint32_t>(i));
+    flatten(bvh_node<T>(std::move(list), time0, time1, gen, split), time0,
+            time1, 0, &index_of);
+  }
+
+  constexpr linear_bvh(bvh_node<T>&& root, T time0, T time1) {
+    flatten(std::move(root), time0, time1, 0);
+  }
+
+  constexpr bool hit(const ray<T>& r, T t_min, T t_max,
+                     hit_record<T>& rec) const noexcept {
+    if (nodes.empty()) return false;
+
+    vec3<T> inv_dir{1 / r.direction.x, 1 / r.direction.y, 1 / r.direction.z};
+    std::array<bool, 3> dir_is_neg{inv_dir.x < 0, inv_dir.y < 0,
+                                   inv_dir.z < 0};
+    std::array<std::uint32_t, stack_size> stack;
+    std::size_t top = 0;
+    std::uint32_t current = 0;
+    bool hit_anything = false;
+
+    while (true) {
+      const auto& node = nodes[current];
+      if (detail::slab_hit(node.box, r.origin, inv_dir, t_min, t_max)) {
+        if (node.count) {
+          for (auto i = node.offset; i < node.offset + node.count; ++i) {
+            if (custom::hit(primitives[i], r, t_min, t_max, rec)) {
+              hit_anything = true;
+              t_max = rec.t;
+            }
+          }
+        } else if (dir_is_neg[node.axis]) {
+          stack[top++] = current + 1;
+          current = node.offset;
+          continue;
+        } else {
+          stack[top++] = node.offset;
+          current = current + 1;
+          continue;
+        }
+      }
+      if (top == 0) break;
+      current = stack[--top];
+    }
+
+    return hit_anything;
+  }
+
+  // Same traversal as hit() without the closest-hit bookkeeping: returns at
+  // the first primitive crossed.
+  constexpr bool occluded(const ray<T>& r, T t_min, T t_max) const noexcept {
+    if (nodes.empty()) return false;
+
+    vec3<T> inv_dir{1 / r.direction.x, 1 / r.direction.y, 1 / r.direction.z};
+    std::array<std::uint32_t, stack_size> stack;
+    std::size_t top = 0;
+    std::uint32_t current = 0;
+
+    while (true) {
+      const auto& node = nodes[current];
+      if (detail::slab_hit(node.box, r.origin, inv_dir, t_min, t_max)) {
+        if (node.count) {
+          for (auto i = node.offset; i < node.offset + node.count; ++i)
+            if (custom::occluded(primitives[i], r, t_min, t_max)) return true;
+        } else {
+          stack[top++] = node.offset;
+          current = current + 1;
+          continue;
+        }
+      }
+      if (top == 0) break;
+      current = stack[--top];
+    }
+
+    return false;
+  }
+
+  constexpr bool bounding_box(T time0, T time1,
+                              aabb<T>& output_box) const noexcept {
+    if (nodes.empty()) return false;
+    output_box = detail::from_float_box<T>(nodes.front().box);
+    return true;
+  }
+
+  // Recomputes every node box bottom-up from the current primitive bounds
+  // over [time0, time1] while keeping the topology, e.g. after primitives
+  // were moved for the next frame of an animation.
+  void refit(T time0, T time1) {
+    if (!nodes.empty()) refit(0, time0, time1);
+  }
+
+ private:
+  aabb<T> refit(std::uint32_t index, T time0, T time1) {
+    auto& node = nodes[index];
+    aabb<T> box{};
+    if (node.count) {
+      for (auto i = node.offset; i < node.offset + node.count; ++i) {
+        aabb<T> b{};
+        if (!custom::bounding_box(primitives[i], time0, time1, b))
+          std::cerr << "No bounding box in linear_bvh::refit.\n";
+        box = i == node.offset ? b : surrounding_box(box, b);
+      }
+    } else {
+      aabb<T> first{}, second{};
+      auto refit_first = [&] { first = refit(index + 1, time0, time1); };
+      auto refit_second = [&] { second = refit(node.offset, time0, time1); };
+      if (node.offset - index > parallel_refit_threshold)
+        parallel_invoke(refit_first, refit_second);
+      else {
+        refit_first();
+        refit_second();
+      }
+      box = surrounding_box(first, second);
+    }
+    node.box = detail::to_float_box(box);
+    return box;
+  }
+
+  static constexpr std::size_t leaf_count(const hittable<T>& h) noexcept {
+    auto node = std::get_if<bvh_node<T>>(&h);
+    if (!node) return 1;
+    return (node->left ? leaf_count(*node->left) : 0) +
+           (node->right ? leaf_count(*node->right) : 0);
+  }
+
+  using index_map = std::unordered_map<const hittable<T>*, std::uint32_t>;
+
+  // Moves every primitive below `h` into `primitives`.
+  constexpr void gather(hittable<T>&& h, const index_map* index_of) {
+    if (auto node = std::get_if<bvh_node<T>>(&h)) {
+      if (node->left) gather(std::move(*node->left), index_of);
+      if (node->right) gather(std::move(*node->right), index_of);
+    } else {
+      if (index_of) order.push_back(index_of->at(&h));
+      primitives.push_back(std::move(h));
+    }
+  }
+
+  constexpr void emit_leaf(hittable<T>&& h, const aabb<T>& box,
+                           const index_map* index_of) {
+    auto first = primitives.size();
+    gather(std::move(h), index_of);
+    nodes.push_back({detail::to_float_box(box),
+                     static_cast<std::uint32_t>(first),
+                     static_cast<std::uint16_t>(primitives.size() - first), 0,
+                     0});
+  }
+
+  // Subtrees that would grow deeper than the traversal stack allows, as
+  // badly skewed SAH trees can, are collapsed into one leaf.
+  constexpr std::uint32_t flatten(hittable<T>&& h, T time0, T time1,
+                                  std::size_t depth,
+                                  const index_map* index_of = nullptr) {
+    auto index = static_cast<std::uint32_t>(nodes.size());
+    aabb<T> box{};
+    if (!custom::bounding_box(h, time0, time1, box))
+      std::cerr << "No bounding box in linear_bvh constructor.\n";
+
+    auto node = std::get_if<bvh_node<T>>(&h);
+    if (!node || leaf_count(h) <= max_leaf_size ||
+        depth + 1 >= stack_size) {
+      emit_leaf(std::move(h), box, index_of);
+      return index;
+    }
+    if (!node->right)
+      return flatten(std::move(*node->left), time0, time1, depth, index_of);
+
+    // Order the children so that the first one lies on the negative side of
+    // the axis along which their centroids are furthest apart.
+    aabb<T> box_left{}, box_right{};
+    custom::bounding_box(*node->left, time0, time1, box_left);
+    custom::bounding_box(*node->right, time0, time1, box_right);
+    auto d = box_right.centroid() - box_left.centroid();
+    std::uint8_t axis = math::abs(d.x) > math::abs(d.y) &&
+                                math::abs(d.x) > math::abs(d.z)
+                            ? 0
+                        : math::abs(d.y) > math::abs(d.z) ? 1
+                                                          : 2;
+    auto first = &node->left;
+    auto second = &node->right;
+    if (std::array{d.x, d.y, d.z}[axis] < 0) std::swap(first, second);
+
+    nodes.push_back({detail::to_float_box(box), 0, 0, axis, 0});
+    flatten(std::move(**first), time0, time1, depth + 1, index_of);
+    auto second_index =
+        flatten(std::move(**second), time0, time1, depth + 1, index_of);
+    nodes[index].offset = second_index;
+    return index;
+  }
+};
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_LINEAR_BVH_HPP
@@ -3,6 +3,7 @@
 #ifndef YK_RAYTRACING_MATERIAL_HPP
 #define YK_RAYTRACING_MATERIAL_HPP
 
+#include <cstdint>
 #include <variant>
 
 #include "color.hpp"
@@ -26,6 +27,10 @@ template <class T>
 using material =
     std::variant<lambertian<T>, metal<T>, dielectric<T>, diffuse_light<T>>;
 
+// Index of a material in the scene's material_table. Primitives and hit
+// records carry this instead of the material itself.
+using material_id = std::uint32_t;
+
 }  // namespace yk
 
 #endif  // !YK_RAYTRACING_MATERIAL_HPP
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_MATERIAL_TABLE_HPP
+#define YK_RAYTRACING_MATERIAL_TABLE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "material.hpp"
+#include "noise_volume.hpp"
+#include "perlin.hpp"
+
+namespace yk {
+
+// Scene-wide storage for materials. Every material lives here exactly once
+// and primitives refer to it by material_id, which keeps primitives small no
+// matter how large the material is. Noise tables used by the materials'
+// textures live in `noises`, and their baked volumes in `baked`.
+template <class T>
+struct material_table {
+  std::vector<material<T>> materials;
+  noise_library<T> noises;
+  std::vector<std::unique_ptr<const baked_noise<T>>> baked;
+
+  template <class M>
+  constexpr material_id add(M&& m) {
+    materials.emplace_back(std::forward<M>(m));
+    return static_cast<material_id>(materials.size() - 1);
+  }
+
+  constexpr const material<T>& operator[](material_id id) const noexcept {
+    return materials[id];
+  }
+
+  constexpr std::size_t size() const noexcept { return materials.size(); }
+};
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_MATERIAL_TABLE_HPP
@@ -27,9 +27,17 @@ struct lambertian {
         rec.normal + random_unit_vector<T>(gen);
     if (scatter_direction.near_zero()) scatter_direction = rec.normal;
     scattered = ray<T>{rec.pos, scatter_direction, r.time};
-    attenuation = custom::value(albedo, rec.u, rec.v, rec.pos);
+    attenuation =
+        custom::value(albedo, rec.u, rec.v, rec.pos, rec.du, rec.dv);
     return true;
   }
+
+  // Density of scatter() choosing `direction` (cosine-weighted).
+  constexpr T scattering_pdf(const hit_record<T>& rec,
+                             const vec3<T>& direction) const noexcept {
+    auto cosine = dot(rec.normal, direction.normalized());
+    return cosine > 0 ? cosine / T(math::numbers::pi) : 0;
+  }
 };
 
 }  // namespace yk
@@ -46,9 +46,11 @@ constexpr T pow(T a, unsigned n) noexcept {
 
 using std::acos;
 using std::atan2;
+using std::ceil;
 using std::cos;
 using std::floor;
 using std::hypot;
+using std::log2;
 using std::sin;
 using std::sqrt;
 using std::tan;
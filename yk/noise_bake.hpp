@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_NOISE_BAKE_HPP
+#define YK_RAYTRACING_NOISE_BAKE_HPP
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "custom.hpp"
+#include "hittable.hpp"
+#include "hittables/hittable_list.hpp"
+#include "material_table.hpp"
+#include "noise_volume.hpp"
+#include "textures/noise_texture.hpp"
+
+namespace yk {
+
+namespace detail {
+
+template <class T, class M, class = void>
+struct has_noise_albedo : std::false_type {};
+
+template <class T, class M>
+struct has_noise_albedo<T, M,
+                        std::void_t<decltype(std::get_if<noise_texture<T>>(
+                            &std::declval<M&>().albedo))>> : std::true_type {};
+
+template <class T, class M, class = void>
+struct has_noise_emit : std::false_type {};
+
+template <class T, class M>
+struct has_noise_emit<T, M,
+                      std::void_t<decltype(std::get_if<noise_texture<T>>(
+                          &std::declval<M&>().emit))>> : std::true_type {};
+
+// The noise_texture a material shades with directly, or nullptr.
+template <class T>
+noise_texture<T>* find_noise_texture(material<T>& m) noexcept {
+  return std::visit(
+      [](auto& mo) -> noise_texture<T>* {
+        using M = std::remove_cv_t<std::remove_reference_t<decltype(mo)>>;
+        if constexpr (has_noise_albedo<T, M>::value)
+          return std::get_if<noise_texture<T>>(&mo.albedo);
+        else if constexpr (has_noise_emit<T, M>::value)
+          return std::get_if<noise_texture<T>>(&mo.emit);
+        else
+          return nullptr;
+      },
+      m);
+}
+
+}  // namespace detail
+
+// Bakes the turb() of every noise_texture in `materials` into a noise_volume
+// of `resolution` cells along the longest side of each object of `world`
+// using it, over [time0, time1]. Each volume is compared with the analytic
+// noise at `samples` random points and reported on std::clog; volumes whose
+// RMS error is above `max_error` are dropped and the analytic noise is kept
+// there, as it is for objects whose volume would take more than `max_bytes`.
+// The error is checked on a small patch of the grid first, so too coarse
+// volumes are dropped before they are baked.
+// The baked volumes are stored in `materials`.
+template <class T, class Gen>
+void bake_noise_textures(const hittable<T>& world,
+                         material_table<T>& materials, std::size_t resolution,
+                         T max_error, T time0, T time1, Gen& gen,
+                         std::size_t samples = 4096,
+                         std::size_t max_bytes = std::size_t(1) << 30) {
+  constexpr T probe_cells = 16;
+  std::vector<std::pair<material_id, aabb<T>>> bounds;
+  custom::for_each_primitive(
+      world, [&](const hittable<T>&, const auto& concrete) {
+        aabb<T> box;
+        if (concrete.bounding_box(time0, time1, box))
+          bounds.emplace_back(concrete.mat, box);
+      });
+
+  for (std::size_t id = 0; id < materials.size(); ++id) {
+    auto texture = detail::find_noise_texture(materials.materials[id]);
+    if (!texture || texture->baked) continue;
+
+    auto baked = std::make_unique<baked_noise<T>>();
+    for (const auto& [mat, box] : bounds) {
+      if (mat != id) continue;
+      auto spacing = noise_volume<T>::spacing_for(box, resolution);
+      noise_volume<T> volume(box, spacing);
+      std::clog << "noise bake : material " << id << ", " << volume.count[0]
+                << 'x' << volume.count[1] << 'x' << volume.count[2] << " ("
+                << volume.bytes() / (1 << 20) << " MiB)";
+      if (volume.bytes() > max_bytes) {
+        std::clog << ", too large\n";
+        continue;
+      }
+
+      // A patch of the same grid at the centre of the box shows whether the
+      // whole of it is worth baking.
+      auto half = probe_cells * spacing / 2;
+      aabb<T> probe_box{box.centroid() - vec3<T>{half, half, half},
+                        box.centroid() + vec3<T>{half, half, half}};
+      noise_volume<T> probe(probe_box, spacing);
+      probe.bake(*texture->noise);
+      auto error =
+          measure_error(probe, *texture->noise, probe_box, samples, gen);
+      if (error.rms <= max_error) {
+        volume.bake(*texture->noise);
+        error = measure_error(volume, *texture->noise, box, samples, gen);
+      }
+      auto keep = error.rms <= max_error;
+      std::clog << ", rms error " << error.rms << " (turb rms "
+                << error.scale << "), max " << error.max
+                << (keep ? "\n" : ", dropped\n");
+      if (keep) baked->volumes.push_back(std::move(volume));
+    }
+    if (baked->volumes.empty()) continue;
+    texture->baked = baked.get();
+    materials.baked.push_back(std::move(baked));
+  }
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_NOISE_BAKE_HPP
@@ -0,0 +1,158 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_NOISE_VOLUME_HPP
+#define YK_RAYTRACING_NOISE_VOLUME_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "aabb.hpp"
+#include "math.hpp"
+#include "parallel.hpp"
+#include "perlin.hpp"
+#include "pos3.hpp"
+#include "random.hpp"
+#include "vec3.hpp"
+
+namespace yk {
+
+// perlin::turb sampled on a regular grid over a box and reconstructed with
+// trilinear interpolation. The grid extends one cell past the box on every
+// side, so points found on the surface of the baked object always fall inside.
+template <class T>
+struct noise_volume {
+  pos3<T> origin;                    // position of grid point (0, 0, 0)
+  T inv_spacing;                     // grid points per unit length
+  std::array<std::size_t, 3> count;  // grid points along x, y and z
+  std::vector<T> values;             // x fastest, then y, then z
+
+  // `resolution` is the number of cells along the longest side of `box`.
+  noise_volume(const perlin<T>& noise, const aabb<T>& box,
+               std::size_t resolution, int depth = 7)
+      : noise_volume(box, spacing_for(box, resolution)) {
+    bake(noise, depth);
+  }
+
+  // Sets up a grid of the given spacing without baking it, so its size and
+  // accuracy can be checked first.
+  noise_volume(const aabb<T>& box, T spacing) : inv_spacing(1 / spacing) {
+    auto extent = box.maximum - box.minimum;
+    origin = box.minimum - vec3<T>{spacing, spacing, spacing};
+    auto points = [&](T e) {
+      return static_cast<std::size_t>(math::ceil(e * inv_spacing)) + 3;
+    };
+    count = {points(extent.x), points(extent.y), points(extent.z)};
+  }
+
+  static constexpr T spacing_for(const aabb<T>& box,
+                                 std::size_t resolution) noexcept {
+    auto extent = box.maximum - box.minimum;
+    auto longest = std::max({extent.x, extent.y, extent.z});
+    return longest / T(std::max<std::size_t>(resolution, 1));
+  }
+
+  // Fills the grid with noise.turb().
+  void bake(const perlin<T>& noise, int depth = 7) {
+    auto spacing = 1 / inv_spacing;
+    values.resize(count[0] * count[1] * count[2]);
+
+    // One batch turb() call per row of the grid.
+    parallel_for(0, count[1] * count[2], [&](std::size_t row) {
+      auto j = row % count[1], k = row / count[1];
+      std::vector<T> x(count[0]), y(count[0], origin.y + j * spacing),
+          z(count[0], origin.z + k * spacing);
+      for (std::size_t i = 0; i < count[0]; ++i)
+        x[i] = origin.x + i * spacing;
+      noise.turb(x.data(), y.data(), z.data(), values.data() + row * count[0],
+                 count[0], depth);
+    });
+  }
+
+  constexpr bool contains(const pos3<T>& p) const noexcept {
+    auto g = (p - origin) * inv_spacing;
+    return g.x >= 0 && g.y >= 0 && g.z >= 0 && g.x <= count[0] - 1 &&
+           g.y <= count[1] - 1 && g.z <= count[2] - 1;
+  }
+
+  // Trilinear reconstruction at `p`, which must be inside the grid.
+  constexpr T lookup(const pos3<T>& p) const noexcept {
+    auto g = (p - origin) * inv_spacing;
+    auto cell = [](T x, std::size_t n, T& t) {
+      auto i = std::min(static_cast<std::size_t>(x), n - 2);
+      t = x - i;
+      return i;
+    };
+    T tx, ty, tz;
+    auto i = cell(g.x, count[0], tx);
+    auto j = cell(g.y, count[1], ty);
+    auto k = cell(g.z, count[2], tz);
+
+    auto at = [&](std::size_t di, std::size_t dj, std::size_t dk) {
+      return values[((k + dk) * count[1] + j + dj) * count[0] + i + di];
+    };
+    auto lerp = [](T a, T b, T t) { return a + (b - a) * t; };
+    return lerp(lerp(lerp(at(0, 0, 0), at(1, 0, 0), tx),
+                     lerp(at(0, 1, 0), at(1, 1, 0), tx), ty),
+                lerp(lerp(at(0, 0, 1), at(1, 0, 1), tx),
+                     lerp(at(0, 1, 1), at(1, 1, 1), tx), ty),
+                tz);
+  }
+
+  std::size_t bytes() const noexcept {
+    return count[0] * count[1] * count[2] * sizeof(T);
+  }
+};
+
+// How far a noise_volume is from the turb() it was baked from.
+template <class T>
+struct noise_volume_error {
+  T max;    // largest absolute error
+  T rms;    // root mean square error
+  T scale;  // root mean square of turb() itself, for comparison
+};
+
+// Compares `volume` with `noise.turb` at `samples` random points of `box`.
+template <class T, class Gen>
+noise_volume_error<T> measure_error(const noise_volume<T>& volume,
+                                    const perlin<T>& noise, const aabb<T>& box,
+                                    std::size_t samples, Gen& gen,
+                                    int depth = 7) {
+  uniform_real_distribution<T> dist(0, 1);
+  noise_volume_error<T> result{0, 0, 0};
+  auto extent = box.maximum - box.minimum;
+  for (std::size_t s = 0; s < samples; ++s) {
+    auto p = box.minimum + vec3<T>{extent.x * dist(gen), extent.y * dist(gen),
+                                   extent.z * dist(gen)};
+    auto exact = noise.turb(vec3<T>{p.x, p.y, p.z}, depth);
+    auto error = math::abs(volume.lookup(p) - exact);
+    result.max = std::max(result.max, error);
+    result.rms += error * error;
+    result.scale += exact * exact;
+  }
+  result.rms = math::sqrt(result.rms / samples);
+  result.scale = math::sqrt(result.scale / samples);
+  return result;
+}
+
+// The baked volumes of one noise_texture, one per object using it. Points
+// outside all of them are left to the analytic noise.
+template <class T>
+struct baked_noise {
+  std::vector<noise_volume<T>> volumes;
+
+  // Writes the baked turb() at `p` to `value`; false when `p` is not covered.
+  constexpr bool lookup(const pos3<T>& p, T& value) const noexcept {
+    for (const auto& volume : volumes)
+      if (volume.contains(p)) {
+        value = volume.lookup(p);
+        return true;
+      }
+    return false;
+  }
+};
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_NOISE_VOLUME_HPP
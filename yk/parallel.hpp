@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_PARALLEL_HPP
+#define YK_RAYTRACING_PARALLEL_HPP
+
+#include <cstddef>
+
+#include "config.hpp"
+
+#if YK_CONFIG_USE_TBB
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#endif
+
+namespace yk {
+
+// Calls f(i) for every i in [first, last), on TBB worker threads when TBB is
+// enabled and sequentially otherwise.
+template <class F>
+void parallel_for(std::size_t first, std::size_t last, F&& f) {
+#if YK_CONFIG_USE_TBB
+  tbb::parallel_for(first, last, f);
+#else
+  for (auto i = first; i < last; ++i) f(i);
+#endif
+}
+
+// Runs f and g, concurrently when TBB is enabled.
+template <class F, class G>
+void parallel_invoke(F&& f, G&& g) {
+#if YK_CONFIG_USE_TBB
+  tbb::parallel_invoke(f, g);
+#else
+  f();
+  g();
+#endif
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_PARALLEL_HPP
@@ -0,0 +1,217 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_PERLIN_HPP
+#define YK_RAYTRACING_PERLIN_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "math.hpp"
+#include "random.hpp"
+#include "simd.hpp"
+#include "vec3.hpp"
+
+namespace yk {
+
+// Gradient noise tables. They are immutable once generated and can be
+// several kilobytes, so they live in a noise_library and textures refer to
+// them by pointer.
+template <class T>
+struct alignas(64) perlin {
+  static constexpr auto point_count = 256;
+  alignas(64) std::array<vec3<T>, point_count> ranvec;
+  alignas(64) vec3<std::array<std::uint8_t, point_count>> perm;
+
+  template <class Gen>
+  constexpr perlin(Gen& gen) noexcept {
+    std::generate(ranvec.begin(), ranvec.end(),
+                  [&]() { return vec3<T>::random(-1, 1, gen); });
+    auto perlin_generate_perm =
+        [&](std::array<std::uint8_t, point_count>& arr) noexcept {
+          std::iota(arr.begin(), arr.end(), 0);
+          for (int i = point_count; i-- > 0;)
+            std::swap(arr[i], arr[uniform_int_distribution<int>(0, i)(gen)]);
+        };
+    perlin_generate_perm(perm.x);
+    perlin_generate_perm(perm.y);
+    perlin_generate_perm(perm.z);
+  }
+
+  perlin(const perlin&) = delete;
+  perlin& operator=(const perlin&) = delete;
+
+  T noise(const vec3<T>& p) const noexcept {
+    auto u = p.x - math::floor(p.x);
+    auto v = p.y - math::floor(p.y);
+    auto w = p.z - math::floor(p.z);
+
+    auto i = static_cast<int>(math::floor(p.x));
+    auto j = static_cast<int>(math::floor(p.y));
+    auto k = static_cast<int>(math::floor(p.z));
+    vec3<T> c[2][2][2];
+
+    for (int di = 0; di < 2; ++di)
+      for (int dj = 0; dj < 2; ++dj)
+        for (int dk = 0; dk < 2; ++dk)
+          c[di][dj][dk] =
+              ranvec[perm.x[(i + di) & 255] ^ perm.y[(j + dj) & 255] ^
+                     perm.z[(k + dk) & 255]];
+
+    return [](vec3<T> c[2][2][2], T u, T v, T w) noexcept {
+      auto uu = u * u * (3 - 2 * u);
+      auto vv = v * v * (3 - 2 * v);
+      auto ww = w * w * (3 - 2 * w);
+      T accum = 0;
+      for (int i = 0; i < 2; ++i)
+        for (int j = 0; j < 2; ++j)
+          for (int k = 0; k < 2; ++k)
+            accum += (i * uu + (1 - i) * (1 - uu)) *
+                     (j * vv + (1 - j) * (1 - vv)) *
+                     (k * ww + (1 - k) * (1 - ww)) *
+                     dot(c[i][j][k], vec3<T>{u - i, v - j, w - k});
+      return accum;
+    }(c, u, v, w);
+  }
+
+  // Evaluates noise() at the n points (x[i], y[i], z[i]) into out[i],
+  // several points at a time in SIMD lanes. Gives the same values as
+  // noise().
+  void noise(const T* x, const T* y, const T* z, T* out,
+             std::size_t n) const noexcept {
+    constexpr auto W = batch_width;
+    std::size_t i = 0;
+    for (; i + W <= n; i += W)
+      noise_lanes(x + i, y + i, z + i).store(out + i);
+    if (i == n) return;
+
+    // Pad the last, partial group.
+    std::array<T, W> px{}, py{}, pz{}, result;
+    std::copy(x + i, x + n, px.begin());
+    std::copy(y + i, y + n, py.begin());
+    std::copy(z + i, z + n, pz.begin());
+    noise_lanes(px.data(), py.data(), pz.data()).store(result.data());
+    std::copy(result.begin(), result.begin() + (n - i), out + i);
+  }
+
+  // Evaluates turb() at the n points (x[i], y[i], z[i]) into out[i], one
+  // point per SIMD lane and octave by octave.
+  void turb(const T* x, const T* y, const T* z, T* out, std::size_t n,
+            int depth = 7) const noexcept {
+    constexpr auto W = batch_width;
+    for (std::size_t i = 0; i < n; i += W) {
+      auto count = std::min(W, n - i);
+      std::array<T, W> px{}, py{}, pz{}, octave;
+      std::array<double, W> accum{};  // as in turb(p)
+      std::copy(x + i, x + i + count, px.begin());
+      std::copy(y + i, y + i + count, py.begin());
+      std::copy(z + i, z + i + count, pz.begin());
+      auto weight = 1.0;
+      for (int d = 0; d < depth; ++d) {
+        noise_lanes(px.data(), py.data(), pz.data()).store(octave.data());
+        for (std::size_t l = 0; l < W; ++l) {
+          accum[l] += weight * octave[l];
+          px[l] *= 2;
+          py[l] *= 2;
+          pz[l] *= 2;
+        }
+        weight *= 0.5;
+      }
+      for (std::size_t l = 0; l < count; ++l) out[i + l] = math::abs(accum[l]);
+    }
+  }
+
+  constexpr T turb(const vec3<T>& p, int depth = 7) const noexcept {
+    auto accum = 0.0;
+    auto temp_p = p;
+    auto weight = 1.0;
+
+    for (int i = 0; i < depth; i++) {
+      accum += weight * noise(temp_p);
+      weight *= 0.5;
+      temp_p *= 2;
+    }
+
+    return math::abs(accum);
+  }
+
+ private:
+  using batch_pack = simd::pack<T, simd::native_width<T>>;
+  static constexpr std::size_t batch_width = batch_pack::width;
+
+  // noise() for batch_width points at once. The lattice hashes are done lane
+  // by lane; the gradients are gathered and interpolated on SIMD packs in the
+  // same order of operations as the scalar code.
+  batch_pack noise_lanes(const T* xs, const T* ys,
+                         const T* zs) const noexcept {
+    using P = batch_pack;
+    constexpr auto W = batch_width;
+
+    auto x = P::load(xs), y = P::load(ys), z = P::load(zs);
+    auto fx = floor(x), fy = floor(y), fz = floor(z);
+    auto u = x - fx, v = y - fy, w = z - fz;
+
+    std::array<T, W> lx, ly, lz;
+    fx.store(lx.data());
+    fy.store(ly.data());
+    fz.store(lz.data());
+    // Indices into ranvec's components of the gradients at the 8 cell
+    // corners, corner = di * 4 + dj * 2 + dk.
+    std::array<std::array<std::int32_t, W>, 8> index;
+    for (std::size_t l = 0; l < W; ++l) {
+      auto i = static_cast<int>(lx[l]);
+      auto j = static_cast<int>(ly[l]);
+      auto k = static_cast<int>(lz[l]);
+      int px[2] = {perm.x[i & 255], perm.x[(i + 1) & 255]};
+      int py[2] = {perm.y[j & 255], perm.y[(j + 1) & 255]};
+      int pz[2] = {perm.z[k & 255], perm.z[(k + 1) & 255]};
+      for (int c = 0; c < 8; ++c)
+        index[c][l] = (px[c >> 2] ^ py[c >> 1 & 1] ^ pz[c & 1]) * 3;
+    }
+    static_assert(sizeof(vec3<T>) == 3 * sizeof(T));
+    const T* base = &ranvec[0].x;
+
+    auto one = P::broadcast(1), two = P::broadcast(2),
+         three = P::broadcast(3), zero = P::broadcast(0);
+    auto uu = u * u * (three - two * u);
+    auto vv = v * v * (three - two * v);
+    auto ww = w * w * (three - two * w);
+    P wu[2] = {one - uu, uu}, wv[2] = {one - vv, vv}, wz[2] = {one - ww, ww};
+    P du[2] = {u, u - one}, dv[2] = {v, v - one}, dw[2] = {w, w - one};
+
+    auto accum = zero;
+    for (int c = 0; c < 8; ++c) {
+      auto di = c >> 2, dj = c >> 1 & 1, dk = c & 1;
+      auto d = P::gather(base, index[c].data()) * du[di] +
+               P::gather(base + 1, index[c].data()) * dv[dj] +
+               P::gather(base + 2, index[c].data()) * dw[dk];
+      accum = accum + wu[di] * wv[dj] * wz[dk] * d;
+    }
+    return accum;
+  }
+};
+
+// Scene-wide storage for noise generators. Each generator is built once and
+// never moves, so the pointers handed out by add() stay valid for as long as
+// the library lives.
+template <class T>
+struct noise_library {
+  std::vector<std::unique_ptr<const perlin<T>>> generators;
+
+  template <class Gen>
+  const perlin<T>* add(Gen& gen) {
+    generators.push_back(std::make_unique<const perlin<T>>(gen));
+    return generators.back().get();
+  }
+
+  constexpr std::size_t size() const noexcept { return generators.size(); }
+};
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_PERLIN_HPP
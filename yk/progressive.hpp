@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_PROGRESSIVE_HPP
+#define YK_RAYTRACING_PROGRESSIVE_HPP
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <vector>
+
+#include "film.hpp"
+
+namespace yk {
+
+// Set by the SIGINT/SIGTERM handler. Render passes in flight end early and
+// progressive renders then stop, keeping the samples they have. The handler
+// puts the default actions back, so a second signal ends the process right
+// away.
+inline volatile std::sig_atomic_t stop_requested = 0;
+
+inline void install_stop_handler() noexcept {
+  auto handler = [](int) {
+    stop_requested = 1;
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+  };
+  std::signal(SIGINT, handler);
+  std::signal(SIGTERM, handler);
+}
+
+// Renders `f` pass by pass: `plan(extra)` chooses how many samples every
+// pixel gets next (false when done) and `pass(extra)` adds them. After a pass
+// `snapshot(f)` is called whenever `interval` seconds have passed since the
+// last snapshot (never when `interval` is not positive). Returns false when
+// the render was stopped before `plan` ran out of work, possibly in the
+// middle of a pass.
+template <class T, class Plan, class Pass, class Snapshot>
+bool render_progressive(film<T>& f, Plan&& plan, Pass&& pass,
+                        double interval, Snapshot&& snapshot) {
+  using clock = std::chrono::steady_clock;
+  auto last = clock::now();
+  std::vector<std::uint32_t> extra;
+  while (plan(extra)) {
+    if (stop_requested) return false;
+    pass(extra);
+    if (stop_requested) return false;
+    auto now = clock::now();
+    if (interval > 0 &&
+        std::chrono::duration<double>(now - last).count() >= interval) {
+      snapshot(f);
+      last = now;
+    }
+  }
+  return true;
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_PROGRESSIVE_HPP
@@ -13,6 +13,9 @@ struct ray {
   pos3<T> origin;
   vec3<T> direction;
   T time = 0;
+  // Width of the cone of directions the ray stands for, per unit of t; 0 for
+  // a thin ray. Textures are filtered over the cone's footprint.
+  T spread = 0;
 
   template <class U>
   constexpr pos3<T> at(const U& scaler) const noexcept {
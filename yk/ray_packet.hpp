@@ -0,0 +1,310 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_RAY_PACKET_HPP
+#define YK_RAYTRACING_RAY_PACKET_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <variant>
+
+#include "custom.hpp"
+#include "hit_record.hpp"
+#include "hittable.hpp"
+#include "hittables/aarect.hpp"
+#include "hittables/sphere.hpp"
+#include "linear_bvh.hpp"
+#include "ray.hpp"
+#include "simd.hpp"
+#include "wide_bvh.hpp"
+
+namespace yk {
+
+// Up to N rays stored lane by lane, traced together through one BVH walk.
+// Lanes past `size` are unused; their t_max is -inf so they never hit.
+template <class T, std::size_t N>
+struct ray_packet {
+  static_assert(N == 4 || N == 8 || N == 16,
+                "ray packets hold 4, 8 or 16 rays");
+
+  std::array<T, N> ox, oy, oz;  // origins
+  std::array<T, N> dx, dy, dz;  // directions
+  std::array<T, N> ix, iy, iz;  // reciprocal directions
+  std::array<T, N> time;
+  std::array<T, N> t_max;  // closest hit so far
+  std::size_t size = 0;
+
+  constexpr void push(const ray<T>& r,
+                      T t = std::numeric_limits<T>::infinity()) noexcept {
+    // Unused lanes replicate the first ray to keep their arithmetic finite.
+    auto first = size == 0;
+    for (auto i = size; i < (first ? N : size + 1); ++i) {
+      ox[i] = r.origin.x;
+      oy[i] = r.origin.y;
+      oz[i] = r.origin.z;
+      dx[i] = r.direction.x;
+      dy[i] = r.direction.y;
+      dz[i] = r.direction.z;
+      ix[i] = 1 / r.direction.x;
+      iy[i] = 1 / r.direction.y;
+      iz[i] = 1 / r.direction.z;
+      time[i] = r.time;
+      t_max[i] = -std::numeric_limits<T>::infinity();
+    }
+    t_max[size++] = t;
+  }
+
+  constexpr ray<T> get(std::size_t i) const noexcept {
+    return {{ox[i], oy[i], oz[i]}, {dx[i], dy[i], dz[i]}, time[i]};
+  }
+
+  // Bit i is set for every used lane.
+  constexpr unsigned lanes() const noexcept { return (1u << size) - 1; }
+};
+
+namespace detail {
+
+// Tests the box against every lane in `lanes`. Returns the lanes that enter
+// it before their closest hit and the entry distance of each lane.
+template <class T, std::size_t N>
+unsigned packet_box_hit(float min_x, float min_y, float min_z, float max_x,
+                        float max_y, float max_z,
+                        const ray_packet<T, N>& p, T t_min, unsigned lanes,
+                        std::array<T, N>& t_near) noexcept {
+  using P = simd::native_pack<T, N>;
+  unsigned mask = 0;
+  for (std::size_t c = 0; c < N; c += P::width) {
+    if (!(lanes >> c & ((1u << P::width) - 1))) continue;
+    auto x0 = (P::broadcast(min_x) - P::load(&p.ox[c])) * P::load(&p.ix[c]);
+    auto x1 = (P::broadcast(max_x) - P::load(&p.ox[c])) * P::load(&p.ix[c]);
+    auto y0 = (P::broadcast(min_y) - P::load(&p.oy[c])) * P::load(&p.iy[c]);
+    auto y1 = (P::broadcast(max_y) - P::load(&p.oy[c])) * P::load(&p.iy[c]);
+    auto z0 = (P::broadcast(min_z) - P::load(&p.oz[c])) * P::load(&p.iz[c]);
+    auto z1 = (P::broadcast(max_z) - P::load(&p.oz[c])) * P::load(&p.iz[c]);
+    auto t0 = max(max(min(x0, x1), min(y0, y1)),
+                  max(min(z0, z1), P::broadcast(t_min)));
+    auto t1 = min(min(max(x0, x1), max(y0, y1)),
+                  min(max(z0, z1), P::load(&p.t_max[c])));
+    t0.store(&t_near[c]);
+    mask |= less_equal(t0, t1) << c;
+  }
+  return mask & lanes;
+}
+
+// Records a hit of `h` at `t` for lane i when it is in range.
+template <class T, std::size_t N>
+bool packet_record(const hittable<T>& h, ray_packet<T, N>& p, T t_min,
+                   std::size_t i, T t,
+                   std::array<hit_record<T>, N>& recs) noexcept {
+  if (t < t_min || p.t_max[i] < t) return false;
+  p.t_max[i] = t;
+  recs[i].t = t;
+  recs[i].object = &h;
+  return true;
+}
+
+// Axis-aligned rectangle in the plane `axis` = k, spanning [a0, a1] x
+// [b0, b1] along the other two axes, against all lanes at once.
+template <class T, std::size_t N, class Member>
+unsigned packet_rect_hit(const hittable<T>& h, ray_packet<T, N>& p, T t_min,
+                         unsigned lanes, std::array<hit_record<T>, N>& recs,
+                         T k, Member o, Member d, Member oa, Member da,
+                         T a0, T a1, Member ob, Member db, T b0,
+                         T b1) noexcept {
+  using P = simd::native_pack<T, N>;
+  std::array<T, N> ts, as, bs;
+  for (std::size_t c = 0; c < N; c += P::width) {
+    auto t = (P::broadcast(k) - P::load(&(p.*o)[c])) / P::load(&(p.*d)[c]);
+    (P::load(&(p.*oa)[c]) + t * P::load(&(p.*da)[c])).store(&as[c]);
+    (P::load(&(p.*ob)[c]) + t * P::load(&(p.*db)[c])).store(&bs[c]);
+    t.store(&ts[c]);
+  }
+  unsigned mask = 0;
+  for (std::size_t i = 0; i < N; ++i) {
+    if (!(lanes >> i & 1)) continue;
+    if (ts[i] < t_min || ts[i] > p.t_max[i]) continue;
+    if (as[i] < a0 || as[i] > a1 || bs[i] < b0 || bs[i] > b1) continue;
+    if (packet_record(h, p, t_min, i, ts[i], recs)) mask |= 1u << i;
+  }
+  return mask;
+}
+
+// Intersects one primitive (or any other hittable) with the lanes in
+// `lanes`. Spheres and rectangles are tested with SIMD over the lanes;
+// everything else falls back to one custom::hit per lane.
+template <class T, std::size_t N>
+unsigned packet_primitive_hit(const hittable<T>& h, ray_packet<T, N>& p,
+                              T t_min, unsigned lanes,
+                              std::array<hit_record<T>, N>& recs) noexcept {
+  using R = ray_packet<T, N>;
+  if (auto s = std::get_if<sphere<T>>(&h)) {
+    using P = simd::native_pack<T, N>;
+    std::array<T, N> disc, near, far;
+    auto zero = P::broadcast(0);
+    for (std::size_t c = 0; c < N; c += P::width) {
+      auto ocx = P::load(&p.ox[c]) - P::broadcast(s->center.x);
+      auto ocy = P::load(&p.oy[c]) - P::broadcast(s->center.y);
+      auto ocz = P::load(&p.oz[c]) - P::broadcast(s->center.z);
+      auto dx = P::load(&p.dx[c]);
+      auto dy = P::load(&p.dy[c]);
+      auto dz = P::load(&p.dz[c]);
+      auto a = dx * dx + dy * dy + dz * dz;
+      auto half_b = ocx * dx + ocy * dy + ocz * dz;
+      auto cc = (ocx * ocx + ocy * ocy + ocz * ocz) -
+                P::broadcast(s->radius * s->radius);
+      auto d = half_b * half_b - a * cc;
+      auto sqrtd = sqrt(max(d, zero));
+      ((zero - half_b - sqrtd) / a).store(&near[c]);
+      ((zero - half_b + sqrtd) / a).store(&far[c]);
+      d.store(&disc[c]);
+    }
+    unsigned mask = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+      if (!(lanes >> i & 1) || disc[i] < 0) continue;
+      if (packet_record(h, p, t_min, i, near[i], recs) ||
+          packet_record(h, p, t_min, i, far[i], recs))
+        mask |= 1u << i;
+    }
+    return mask;
+  }
+  if (auto r = std::get_if<xy_rect<T>>(&h))
+    return packet_rect_hit(h, p, t_min, lanes, recs, r->k, &R::oz, &R::dz,
+                           &R::ox, &R::dx, r->x0, r->x1, &R::oy, &R::dy,
+                           r->y0, r->y1);
+  if (auto r = std::get_if<xz_rect<T>>(&h))
+    return packet_rect_hit(h, p, t_min, lanes, recs, r->k, &R::oy, &R::dy,
+                           &R::ox, &R::dx, r->x0, r->x1, &R::oz, &R::dz,
+                           r->z0, r->z1);
+  if (auto r = std::get_if<yz_rect<T>>(&h))
+    return packet_rect_hit(h, p, t_min, lanes, recs, r->k, &R::ox, &R::dx,
+                           &R::oy, &R::dy, r->y0, r->y1, &R::oz, &R::dz,
+                           r->z0, r->z1);
+
+  unsigned mask = 0;
+  for (std::size_t i = 0; i < N; ++i) {
+    if (!(lanes >> i & 1)) continue;
+    if (custom::hit(h, p.get(i), t_min, p.t_max[i], recs[i])) {
+      p.t_max[i] = recs[i].t;
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+
+template <class T, std::size_t N>
+unsigned packet_hit(const linear_bvh<T>& bvh, ray_packet<T, N>& p, T t_min,
+                    std::array<hit_record<T>, N>& recs) noexcept {
+  if (bvh.nodes.empty()) return 0;
+  // Children are visited in the order that suits the first ray.
+  std::array<bool, 3> dir_is_neg = {p.dx[0] < 0, p.dy[0] < 0, p.dz[0] < 0};
+  std::array<std::uint32_t, linear_bvh<T>::stack_size> stack;
+  std::array<T, N> t_near;
+  std::size_t top = 0;
+  stack[top++] = 0;
+  unsigned result = 0;
+
+  while (top) {
+    auto index = stack[--top];
+    const auto& node = bvh.nodes[index];
+    auto mask = packet_box_hit(node.box.minimum.x, node.box.minimum.y,
+                               node.box.minimum.z, node.box.maximum.x,
+                               node.box.maximum.y, node.box.maximum.z, p,
+                               t_min, p.lanes(), t_near);
+    if (!mask) continue;
+    if (node.count) {
+      for (auto i = node.offset; i < node.offset + node.count; ++i)
+        result |= packet_primitive_hit(bvh.primitives[i], p, t_min, mask,
+                                       recs);
+    } else if (dir_is_neg[node.axis]) {
+      stack[top++] = index + 1;
+      stack[top++] = node.offset;
+    } else {
+      stack[top++] = node.offset;
+      stack[top++] = index + 1;
+    }
+  }
+  return result;
+}
+
+template <class T, std::size_t Width, std::size_t N>
+unsigned packet_hit(const wide_bvh<T, Width>& bvh, ray_packet<T, N>& p,
+                    T t_min, std::array<hit_record<T>, N>& recs) noexcept {
+  if (bvh.nodes.empty()) return 0;
+  struct entry {
+    T t_near;
+    std::uint32_t child;
+    std::uint16_t count;
+    unsigned lanes;
+  };
+  std::array<entry, wide_bvh<T, Width>::stack_size> stack;
+  std::array<T, N> t_near;
+  std::size_t top = 0;
+  stack[top++] = {t_min, 0, 0, p.lanes()};
+  unsigned result = 0;
+
+  while (top) {
+    auto [near, child, count, lanes] = stack[--top];
+    // Lanes that found a hit in front of the entry since it was pushed are
+    // done with it; `near` is the closest any of its lanes enters it.
+    for (std::size_t i = 0; i < N; ++i)
+      if (p.t_max[i] < near) lanes &= ~(1u << i);
+    if (!lanes) continue;
+    if (count) {
+      for (auto i = child; i < child + count; ++i)
+        result |= packet_primitive_hit(bvh.primitives[i], p, t_min, lanes,
+                                       recs);
+      continue;
+    }
+
+    const auto& node = bvh.nodes[child];
+    std::array<entry, Width> hits;
+    std::size_t n = 0;
+    for (std::size_t c = 0; c < Width; ++c) {
+      if (!(node.min_x[c] <= node.max_x[c])) continue;  // unused lane
+      auto mask = packet_box_hit(node.min_x[c], node.min_y[c], node.min_z[c],
+                                 node.max_x[c], node.max_y[c], node.max_z[c],
+                                 p, t_min, lanes, t_near);
+      if (!mask) continue;
+      auto closest = std::numeric_limits<T>::infinity();
+      for (std::size_t i = 0; i < N; ++i)
+        if (mask >> i & 1) closest = std::min(closest, t_near[i]);
+      hits[n++] = {closest, node.child[c], node.count[c], mask};
+    }
+    // Farthest first, so the nearest child is popped next.
+    insertion_sort(hits, n, [](const auto& a, const auto& b) {
+      return a.t_near > b.t_near;
+    });
+    for (std::size_t i = 0; i < n; ++i) stack[top++] = hits[i];
+  }
+  return result;
+}
+
+}  // namespace detail
+
+// Finds the closest hit of every ray in `packet` with `world`, walking BVHs
+// once for the whole packet. Like custom::hit only rec.t and rec.object are
+// filled in. Returns the lanes that hit something; packet.t_max holds their
+// hit distances.
+template <class T, std::size_t N>
+unsigned hit_packet(const hittable<T>& world, ray_packet<T, N>& packet,
+                    T t_min, std::array<hit_record<T>, N>& recs) noexcept {
+  return std::visit(
+      [&](const auto& h) -> unsigned {
+        using H = std::remove_cv_t<std::remove_reference_t<decltype(h)>>;
+        if constexpr (std::is_same_v<H, linear_bvh<T>> ||
+                      std::is_same_v<H, wide_bvh<T, 4>> ||
+                      std::is_same_v<H, wide_bvh<T, 8>>)
+          return detail::packet_hit(h, packet, t_min, recs);
+        else
+          return detail::packet_primitive_hit(world, packet, t_min,
+                                              packet.lanes(), recs);
+      },
+      world);
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_RAY_PACKET_HPP
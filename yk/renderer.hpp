@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_RENDERER_HPP
+#define YK_RAYTRACING_RENDERER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "color.hpp"
+#include "config.hpp"
+#include "film.hpp"
+#include "hit_record.hpp"
+#include "hittable.hpp"
+#include "integrator.hpp"
+#include "light_list.hpp"
+#include "material_table.hpp"
+#include "progressive.hpp"
+#include "ray.hpp"
+#include "ray_packet.hpp"
+#include "sampler.hpp"
+#include "tile_scheduler.hpp"
+#include "wavefront.hpp"
+
+namespace yk {
+
+// Adds extra[p] samples to every pixel p of `f`. Sample s of pixel p always
+// draws from philox_sampler(seed, p, s), so the film only depends on how many
+// samples each pixel received, not on how they were split into passes.
+//
+// Uses render_wavefront when `wavefront` is set and every pixel gets the same
+// number of samples, and otherwise traces tiles, with camera rays in packets
+// of constants::ray_packet_size. `ray_gen(x, y, sampler)` returns the camera
+// ray of one sample.
+//
+// Once stop_requested is set the pass ends early. Every pixel then has a
+// prefix of its extra samples, so the film stays valid for later passes.
+template <class T, class RayGen>
+void render_pass(film<T>& f, const std::vector<std::uint32_t>& extra,
+                 std::uint64_t seed, RayGen&& ray_gen,
+                 const color<T>& background, const hittable<T>& world,
+                 const material_table<T>& materials,
+                 const light_list<T>& lights) {
+  constexpr auto max_depth = constants::max_depth;
+  if (f.size() == 0) return;
+
+  bool uniform =
+      std::all_of(extra.begin(), extra.end(),
+                  [&](auto n) { return n == extra.front(); }) &&
+      std::all_of(f.count.begin(), f.count.end(),
+                  [&](auto n) { return n == f.count.front(); });
+  if (wavefront && uniform) {
+    render_wavefront<T>(
+        f.width, f.height, f.count.front(), extra.front(), seed, ray_gen,
+        [&](std::size_t p, const color<T>& c) { f.add_sample(p, c); },
+        background, world, materials, lights, max_depth, wave_size);
+    return;
+  }
+
+  if constexpr (constants::ray_packet_size > 1) {
+    constexpr auto N = constants::ray_packet_size;
+    for_each_tile(f.width, f.height, tile_size, [&](const tile& t) {
+      if (stop_requested) return;
+      // Runs of N neighbouring pixels that need samples share one camera ray
+      // packet per sample; every path continues on its own after the first
+      // hit.
+      std::array<std::size_t, N> pixels;
+      std::array<std::uint32_t, N> first;
+      std::array<philox_sampler, N> samplers;
+      std::array<ray<T>, N> rays;
+      std::array<hit_record<T>, N> recs;
+      auto tile_width = t.x1 - t.x0;
+      auto count = tile_width * (t.y1 - t.y0);
+      std::size_t next = 0;
+      while (next < count) {
+        std::size_t n = 0;
+        std::uint32_t samples = 0;
+        for (; next < count && n < N; ++next) {
+          auto p = (t.y0 + next / tile_width) * f.width + t.x0 +
+                   next % tile_width;
+          if (!extra[p]) continue;
+          pixels[n] = p;
+          first[n++] = f.count[p];
+          samples = std::max(samples, extra[p]);
+        }
+
+        for (std::uint32_t s = 0; s < samples && !stop_requested; ++s) {
+          ray_packet<T, N> packet;
+          std::array<std::size_t, N> lane_of;
+          for (std::size_t i = 0; i < n; ++i) {
+            if (s >= extra[pixels[i]]) continue;
+            samplers[i] = philox_sampler(seed, pixels[i], first[i] + s);
+            rays[i] = ray_gen(pixels[i] % f.width, pixels[i] / f.width,
+                              samplers[i]);
+            lane_of[packet.size] = i;
+            packet.push(rays[i]);
+          }
+          recs = {};
+          auto mask = hit_packet(world, packet, T(0.001), recs);
+          for (std::size_t lane = 0; lane < packet.size; ++lane) {
+            auto i = lane_of[lane];
+            f.add_sample(pixels[i],
+                         trace_path(rays[i], bool(mask >> lane & 1),
+                                    recs[lane], background, world, materials,
+                                    lights, max_depth, samplers[i]));
+          }
+        }
+      }
+    });
+  } else {
+    for_each_pixel_tiled(
+        f.width, f.height, tile_size, [&](std::size_t x, std::size_t y) {
+          auto p = y * f.width + x;
+          auto first = f.count[p];
+          for (std::uint32_t s = 0; s < extra[p] && !stop_requested; ++s) {
+            philox_sampler sampler(seed, p, first + s);
+            f.add_sample(p, trace_path(ray_gen(x, y, sampler), background,
+                                       world, materials, lights, max_depth,
+                                       sampler));
+          }
+        });
+  }
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_RENDERER_HPP
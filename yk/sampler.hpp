@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_SAMPLER_HPP
+#define YK_RAYTRACING_SAMPLER_HPP
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace yk {
+
+namespace detail {
+
+// Philox4x32-10 block cipher (Salmon et al. 2011): maps a 128-bit counter
+// and a 64-bit key to 128 random bits.
+constexpr std::array<std::uint32_t, 4> philox4x32(
+    std::array<std::uint32_t, 4> ctr,
+    std::array<std::uint32_t, 2> key) noexcept {
+  constexpr std::uint32_t m0 = 0xd2511f53, m1 = 0xcd9e8d57;
+  constexpr std::uint32_t w0 = 0x9e3779b9, w1 = 0xbb67ae85;
+  for (int round = 0; round < 10; ++round) {
+    auto p0 = std::uint64_t(m0) * ctr[0];
+    auto p1 = std::uint64_t(m1) * ctr[2];
+    ctr = {std::uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], std::uint32_t(p1),
+           std::uint32_t(p0 >> 32) ^ ctr[3] ^ key[1], std::uint32_t(p0)};
+    key[0] += w0;
+    key[1] += w1;
+  }
+  return ctr;
+}
+
+}  // namespace detail
+
+// Counter-based random number generator for one sample of one pixel. The
+// n-th number drawn is a pure function of (seed, pixel, sample, n), so any
+// thread can produce any sample without shared state and the image does not
+// depend on how the work was scheduled. Models UniformRandomBitGenerator and
+// can be passed wherever a `Gen&` is expected.
+class philox_sampler {
+ public:
+  using result_type = std::uint32_t;
+
+  constexpr philox_sampler() noexcept : philox_sampler(0, 0, 0) {}
+
+  constexpr philox_sampler(std::uint64_t seed, std::uint64_t pixel,
+                           std::uint64_t sample) noexcept
+      : counter_{0, std::uint32_t(sample), std::uint32_t(pixel),
+                 std::uint32_t(pixel >> 32)},
+        key_{std::uint32_t(seed),
+             std::uint32_t(seed >> 32) ^ std::uint32_t(sample >> 32)} {}
+
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  constexpr result_type operator()() noexcept {
+    if (dimension_ % 4 == 0) {
+      counter_[0] = dimension_ / 4;
+      block_ = detail::philox4x32(counter_, key_);
+    }
+    return block_[dimension_++ % 4];
+  }
+
+  // Index of the next number to be drawn.
+  constexpr std::uint32_t dimension() const noexcept { return dimension_; }
+
+  // Jumps to the d-th number of this stream, e.g. to give each bounce a
+  // fixed range of dimensions.
+  constexpr void set_dimension(std::uint32_t d) noexcept {
+    dimension_ = d;
+    if (d % 4 != 0) {
+      counter_[0] = d / 4;
+      block_ = detail::philox4x32(counter_, key_);
+    }
+  }
+
+ private:
+  std::array<std::uint32_t, 4> counter_;
+  std::array<std::uint32_t, 2> key_;
+  std::array<std::uint32_t, 4> block_{};
+  std::uint32_t dimension_ = 0;
+};
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_SAMPLER_HPP
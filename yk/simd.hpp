@@ -0,0 +1,309 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_SIMD_HPP
+#define YK_RAYTRACING_SIMD_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define YK_SIMD_AVX 1
+#define YK_SIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YK_SIMD_SSE2 1
+#endif
+
+namespace yk::simd {
+
+// N lanes of T. The primary template is a plain lane loop and serves as the
+// scalar fallback; the specializations below map onto SSE/AVX registers.
+template <class T, std::size_t N>
+struct pack {
+  static constexpr std::size_t width = N;
+
+  std::array<T, N> v;
+
+  static pack broadcast(T x) noexcept {
+    pack p;
+    p.v.fill(x);
+    return p;
+  }
+
+  template <class U>
+  static pack load(const U* ptr) noexcept {
+    pack p;
+    for (std::size_t i = 0; i < N; ++i) p.v[i] = static_cast<T>(ptr[i]);
+    return p;
+  }
+
+  // Lane i = base[index[i]].
+  static pack gather(const T* base, const std::int32_t* index) noexcept {
+    pack p;
+    for (std::size_t i = 0; i < N; ++i) p.v[i] = base[index[i]];
+    return p;
+  }
+
+  void store(T* ptr) const noexcept { std::copy(v.begin(), v.end(), ptr); }
+
+  friend pack operator+(pack a, const pack& b) noexcept {
+    for (std::size_t i = 0; i < N; ++i) a.v[i] += b.v[i];
+    return a;
+  }
+  friend pack operator-(pack a, const pack& b) noexcept {
+    for (std::size_t i = 0; i < N; ++i) a.v[i] -= b.v[i];
+    return a;
+  }
+  friend pack operator*(pack a, const pack& b) noexcept {
+    for (std::size_t i = 0; i < N; ++i) a.v[i] *= b.v[i];
+    return a;
+  }
+  friend pack operator/(pack a, const pack& b) noexcept {
+    for (std::size_t i = 0; i < N; ++i) a.v[i] /= b.v[i];
+    return a;
+  }
+  friend pack sqrt(pack a) noexcept {
+    for (auto& x : a.v) x = std::sqrt(x);
+    return a;
+  }
+  friend pack floor(pack a) noexcept {
+    for (auto& x : a.v) x = std::floor(x);
+    return a;
+  }
+  friend pack min(pack a, const pack& b) noexcept {
+    for (std::size_t i = 0; i < N; ++i) a.v[i] = std::min(a.v[i], b.v[i]);
+    return a;
+  }
+  friend pack max(pack a, const pack& b) noexcept {
+    for (std::size_t i = 0; i < N; ++i) a.v[i] = std::max(a.v[i], b.v[i]);
+    return a;
+  }
+  // Bit i is set when a[i] <= b[i].
+  friend unsigned less_equal(const pack& a, const pack& b) noexcept {
+    unsigned mask = 0;
+    for (std::size_t i = 0; i < N; ++i)
+      mask |= unsigned(a.v[i] <= b.v[i]) << i;
+    return mask;
+  }
+};
+
+#if YK_SIMD_SSE2
+
+template <>
+struct pack<float, 4> {
+  static constexpr std::size_t width = 4;
+
+  __m128 v;
+
+  static pack broadcast(float x) noexcept { return {_mm_set1_ps(x)}; }
+  static pack load(const float* ptr) noexcept { return {_mm_loadu_ps(ptr)}; }
+  static pack gather(const float* base, const std::int32_t* index) noexcept {
+    return {_mm_set_ps(base[index[3]], base[index[2]], base[index[1]],
+                       base[index[0]])};
+  }
+  void store(float* ptr) const noexcept { _mm_storeu_ps(ptr, v); }
+
+  friend pack operator+(pack a, pack b) noexcept {
+    return {_mm_add_ps(a.v, b.v)};
+  }
+  friend pack operator-(pack a, pack b) noexcept {
+    return {_mm_sub_ps(a.v, b.v)};
+  }
+  friend pack operator*(pack a, pack b) noexcept {
+    return {_mm_mul_ps(a.v, b.v)};
+  }
+  friend pack operator/(pack a, pack b) noexcept {
+    return {_mm_div_ps(a.v, b.v)};
+  }
+  friend pack sqrt(pack a) noexcept { return {_mm_sqrt_ps(a.v)}; }
+  // SSE2 has no rounding instruction, so this one goes lane by lane.
+  friend pack floor(pack a) noexcept {
+    alignas(16) float x[4];
+    _mm_store_ps(x, a.v);
+    for (auto& f : x) f = std::floor(f);
+    return {_mm_load_ps(x)};
+  }
+  friend pack min(pack a, pack b) noexcept { return {_mm_min_ps(a.v, b.v)}; }
+  friend pack max(pack a, pack b) noexcept { return {_mm_max_ps(a.v, b.v)}; }
+  friend unsigned less_equal(pack a, pack b) noexcept {
+    return static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(a.v, b.v)));
+  }
+};
+
+template <>
+struct pack<double, 2> {
+  static constexpr std::size_t width = 2;
+
+  __m128d v;
+
+  static pack broadcast(double x) noexcept { return {_mm_set1_pd(x)}; }
+  static pack load(const double* ptr) noexcept { return {_mm_loadu_pd(ptr)}; }
+  static pack load(const float* ptr) noexcept {
+    return {_mm_set_pd(ptr[1], ptr[0])};
+  }
+  static pack gather(const double* base,
+                     const std::int32_t* index) noexcept {
+    return {_mm_set_pd(base[index[1]], base[index[0]])};
+  }
+  void store(double* ptr) const noexcept { _mm_storeu_pd(ptr, v); }
+
+  friend pack operator+(pack a, pack b) noexcept {
+    return {_mm_add_pd(a.v, b.v)};
+  }
+  friend pack operator-(pack a, pack b) noexcept {
+    return {_mm_sub_pd(a.v, b.v)};
+  }
+  friend pack operator*(pack a, pack b) noexcept {
+    return {_mm_mul_pd(a.v, b.v)};
+  }
+  friend pack operator/(pack a, pack b) noexcept {
+    return {_mm_div_pd(a.v, b.v)};
+  }
+  friend pack sqrt(pack a) noexcept { return {_mm_sqrt_pd(a.v)}; }
+  // SSE2 has no rounding instruction, so this one goes lane by lane.
+  friend pack floor(pack a) noexcept {
+    alignas(16) double x[2];
+    _mm_store_pd(x, a.v);
+    return {_mm_set_pd(std::floor(x[1]), std::floor(x[0]))};
+  }
+  friend pack min(pack a, pack b) noexcept { return {_mm_min_pd(a.v, b.v)}; }
+  friend pack max(pack a, pack b) noexcept { return {_mm_max_pd(a.v, b.v)}; }
+  friend unsigned less_equal(pack a, pack b) noexcept {
+    return static_cast<unsigned>(_mm_movemask_pd(_mm_cmple_pd(a.v, b.v)));
+  }
+};
+
+#endif  // YK_SIMD_SSE2
+
+#if YK_SIMD_AVX
+
+template <>
+struct pack<float, 8> {
+  static constexpr std::size_t width = 8;
+
+  __m256 v;
+
+  static pack broadcast(float x) noexcept { return {_mm256_set1_ps(x)}; }
+  static pack load(const float* ptr) noexcept {
+    return {_mm256_loadu_ps(ptr)};
+  }
+  static pack gather(const float* base, const std::int32_t* index) noexcept {
+#if defined(__AVX2__)
+    auto i = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index));
+    return {_mm256_i32gather_ps(base, i, 4)};
+#else
+    return {_mm256_set_ps(base[index[7]], base[index[6]], base[index[5]],
+                          base[index[4]], base[index[3]], base[index[2]],
+                          base[index[1]], base[index[0]])};
+#endif
+  }
+  void store(float* ptr) const noexcept { _mm256_storeu_ps(ptr, v); }
+
+  friend pack operator+(pack a, pack b) noexcept {
+    return {_mm256_add_ps(a.v, b.v)};
+  }
+  friend pack operator-(pack a, pack b) noexcept {
+    return {_mm256_sub_ps(a.v, b.v)};
+  }
+  friend pack operator*(pack a, pack b) noexcept {
+    return {_mm256_mul_ps(a.v, b.v)};
+  }
+  friend pack operator/(pack a, pack b) noexcept {
+    return {_mm256_div_ps(a.v, b.v)};
+  }
+  friend pack sqrt(pack a) noexcept { return {_mm256_sqrt_ps(a.v)}; }
+  friend pack floor(pack a) noexcept { return {_mm256_floor_ps(a.v)}; }
+  friend pack min(pack a, pack b) noexcept {
+    return {_mm256_min_ps(a.v, b.v)};
+  }
+  friend pack max(pack a, pack b) noexcept {
+    return {_mm256_max_ps(a.v, b.v)};
+  }
+  friend unsigned less_equal(pack a, pack b) noexcept {
+    return static_cast<unsigned>(
+        _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)));
+  }
+};
+
+template <>
+struct pack<double, 4> {
+  static constexpr std::size_t width = 4;
+
+  __m256d v;
+
+  static pack broadcast(double x) noexcept { return {_mm256_set1_pd(x)}; }
+  static pack load(const double* ptr) noexcept {
+    return {_mm256_loadu_pd(ptr)};
+  }
+  static pack load(const float* ptr) noexcept {
+    return {_mm256_cvtps_pd(_mm_loadu_ps(ptr))};
+  }
+  static pack gather(const double* base,
+                     const std::int32_t* index) noexcept {
+#if defined(__AVX2__)
+    auto i = _mm_loadu_si128(reinterpret_cast<const __m128i*>(index));
+    return {_mm256_i32gather_pd(base, i, 8)};
+#else
+    return {_mm256_set_pd(base[index[3]], base[index[2]], base[index[1]],
+                          base[index[0]])};
+#endif
+  }
+  void store(double* ptr) const noexcept { _mm256_storeu_pd(ptr, v); }
+
+  friend pack operator+(pack a, pack b) noexcept {
+    return {_mm256_add_pd(a.v, b.v)};
+  }
+  friend pack operator-(pack a, pack b) noexcept {
+    return {_mm256_sub_pd(a.v, b.v)};
+  }
+  friend pack operator*(pack a, pack b) noexcept {
+    return {_mm256_mul_pd(a.v, b.v)};
+  }
+  friend pack operator/(pack a, pack b) noexcept {
+    return {_mm256_div_pd(a.v, b.v)};
+  }
+  friend pack sqrt(pack a) noexcept { return {_mm256_sqrt_pd(a.v)}; }
+  friend pack floor(pack a) noexcept { return {_mm256_floor_pd(a.v)}; }
+  friend pack min(pack a, pack b) noexcept {
+    return {_mm256_min_pd(a.v, b.v)};
+  }
+  friend pack max(pack a, pack b) noexcept {
+    return {_mm256_max_pd(a.v, b.v)};
+  }
+  friend unsigned less_equal(pack a, pack b) noexcept {
+    return static_cast<unsigned>(
+        _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)));
+  }
+};
+
+#endif  // YK_SIMD_AVX
+
+// Number of lanes of T that fit in the widest register enabled at compile
+// time, or 1 when no SIMD instruction set is available.
+template <class T>
+inline constexpr std::size_t native_width = 1;
+
+#if YK_SIMD_AVX
+template <>
+inline constexpr std::size_t native_width<float> = 8;
+template <>
+inline constexpr std::size_t native_width<double> = 4;
+#elif YK_SIMD_SSE2
+template <>
+inline constexpr std::size_t native_width<float> = 4;
+template <>
+inline constexpr std::size_t native_width<double> = 2;
+#endif
+
+// Widest register-backed pack that evenly divides a group of N lanes.
+template <class T, std::size_t N>
+using native_pack = pack<T, std::min(N, native_width<T>)>;
+
+}  // namespace yk::simd
+
+#endif  // !YK_RAYTRACING_SIMD_HPP
@@ -6,9 +6,15 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstdint>
+#include <iostream>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "../color.hpp"
+#include "../config.hpp"
+#include "../math.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "../../thirdparty/stb_image.h"
 
@@ -17,36 +23,204 @@ namespace yk {
 template <class T>
 struct image_texture {
   static constexpr int bytes_per_pixel = 3;
-  std::shared_ptr<std::byte> data;
-  int width, height, bytes_per_scanline;
+  static constexpr int tile_size = 8;  // texels along a side of a tile
 
-  image_texture(const char* filename) {
+  // Texel (i, j) of a level starts at element columns[i] + rows[j] of its
+  // storage, which makes the layout a matter of how the tables are filled.
+  // Scanline levels keep stb's packed RGB rows. Tiled levels store tiles of
+  // tile_size x tile_size texels in scanline order, the texels of a tile in
+  // Morton order and padded to 4 channels, so the 2x2 texels of a bilinear
+  // lookup usually share a cache line whichever way the lookups move.
+  struct mip_level {
+    int width, height;
+    std::vector<std::size_t> columns, rows;
+    std::vector<std::uint8_t> bytes;  // 8-bit storage
+    std::vector<float> floats;        // float storage, scaled to [0, 1]
+  };
+
+  // Level 0 is the image itself and every further level halves the one
+  // before it, down to 1x1. Shared by copies, as the levels never change.
+  std::shared_ptr<const std::vector<mip_level>> levels;
+  int width, height;
+
+  // With `tiled` the levels are laid out in tiles, and with `float_storage`
+  // their texels are kept as floats instead of bytes.
+  image_texture(const char* filename, bool tiled = texture_tiled,
+                bool float_storage = texture_float) {
     auto components_per_pixel = bytes_per_pixel;
-    data.reset(reinterpret_cast<std::byte*>(stbi_load(filename, &width, &height,
-                                                      &components_per_pixel,
-                                                      components_per_pixel)));
+    std::unique_ptr<stbi_uc, void (*)(void*)> data(
+        stbi_load(filename, &width, &height, &components_per_pixel,
+                  components_per_pixel),
+        stbi_image_free);
     if (!data) {
       std::cerr << "ERROR: Could not load texture image file '" << filename
                 << "'.\n";
       width = height = 0;
+      return;
     }
-    bytes_per_scanline = bytes_per_pixel * width;
+    levels = std::make_shared<const std::vector<mip_level>>(
+        build_levels(data.get(), width, height, tiled, float_storage));
   }
-  color<T> value(T u, T v, const pos3<T>&) const noexcept {
-    if (!data) return {0, 1, 1};
+
+  // Point samples the texture at (u, v) unless a footprint of du by dv is
+  // given, in which case the two mip levels closest to it are interpolated.
+  color<T> value(T u, T v, const pos3<T>&, T du = 0,
+                 T dv = 0) const noexcept {
+    if (!levels) return {0, 1, 1};
     u = std::clamp<T>(u, 0, 1);
     v = 1 - std::clamp<T>(v, 0, 1);
-    auto i = std::min<int>(u * width, width - 1);
-    auto j = std::min<int>(v * height, height - 1);
+    const auto& base = (*levels)[0];
+    if (du == 0 && dv == 0) {
+      auto i = std::min<int>(u * base.width, base.width - 1);
+      auto j = std::min<int>(v * base.height, base.height - 1);
+      return texel(base, i, j);
+    }
+
+    // Trilinear filtering; the footprint is taken as the square covering
+    // its longer side.
+    auto texels = std::max(du * base.width, dv * base.height);
+    auto lod = std::clamp<T>(math::log2(std::max<T>(texels, 1)), 0,
+                             T(levels->size() - 1));
+    auto l = std::min(static_cast<std::size_t>(lod), levels->size() - 1);
+    auto c = bilinear((*levels)[l], u, v);
+    if (auto t = lod - l; t > 0)
+      c = (1 - t) * c + t * bilinear((*levels)[l + 1], u, v);
+    return c;
+  }
+
+ private:
+  // A level in stb's layout, while the pyramid is built.
+  struct scanline_image {
+    int width, height;
+    std::vector<std::uint8_t> rgb;
+  };
+
+  // Spreads the bits of x apart, for Morton order within a tile.
+  static constexpr std::size_t interleave(int x) noexcept {
+    std::size_t result = 0;
+    for (int bit = 0; (tile_size >> bit) > 1; ++bit)
+      result |= std::size_t(x >> bit & 1) << (2 * bit);
+    return result;
+  }
+
+  template <class U>
+  static color<T> texel(const U* data, std::size_t k, T scale) noexcept {
+    return {scale * data[k], scale * data[k + 1], scale * data[k + 2]};
+  }
 
-    constexpr auto color_scale = T{1} / 255;
-    auto pixel = data.get() + j * bytes_per_scanline + i * bytes_per_pixel;
+  static color<T> texel(const mip_level& level, int i, int j) noexcept {
+    auto k = level.columns[i] + level.rows[j];
+    if (!level.floats.empty()) return texel(level.floats.data(), k, T(1));
+    return texel(level.bytes.data(), k, T{1} / 255);
+  }
+
+  static color<T> bilinear(const mip_level& level, T u, T v) noexcept {
+    auto x = u * level.width - T(0.5), y = v * level.height - T(0.5);
+    auto fx = math::floor(x), fy = math::floor(y);
+    auto tx = x - fx, ty = y - fy;
+    auto i0 = std::clamp(static_cast<int>(fx), 0, level.width - 1);
+    auto j0 = std::clamp(static_cast<int>(fy), 0, level.height - 1);
+    auto i1 = std::min(i0 + 1, level.width - 1);
+    auto j1 = std::min(j0 + 1, level.height - 1);
+    if (fx < 0) i1 = i0;
+    if (fy < 0) j1 = j0;
 
-    return {
-        color_scale * static_cast<std::underlying_type_t<std::byte>>(pixel[0]),
-        color_scale * static_cast<std::underlying_type_t<std::byte>>(pixel[1]),
-        color_scale * static_cast<std::underlying_type_t<std::byte>>(pixel[2]),
+    auto c0 = level.columns[i0], c1 = level.columns[i1];
+    auto r0 = level.rows[j0], r1 = level.rows[j1];
+    auto filter = [&](const auto* data, T scale) {
+      return (1 - ty) * ((1 - tx) * texel(data, c0 + r0, scale) +
+                         tx * texel(data, c1 + r0, scale)) +
+             ty * ((1 - tx) * texel(data, c0 + r1, scale) +
+                   tx * texel(data, c1 + r1, scale));
     };
+    if (!level.floats.empty()) return filter(level.floats.data(), T(1));
+    return filter(level.bytes.data(), T{1} / 255);
+  }
+
+  // Each texel of a level averages the 2x2 texels below it; at the far edge
+  // of an odd-sized level the last row or column of three is averaged.
+  static scanline_image downsample(const scanline_image& src) {
+    scanline_image dst{std::max(src.width / 2, 1), std::max(src.height / 2, 1),
+                       {}};
+    dst.rgb.resize(std::size_t(dst.width) * dst.height * bytes_per_pixel);
+    for (int j = 0; j < dst.height; ++j)
+      for (int i = 0; i < dst.width; ++i)
+        for (int c = 0; c < bytes_per_pixel; ++c) {
+          int sum = 0, count = 0;
+          auto y1 = j + 1 == dst.height ? src.height : 2 * j + 2;
+          auto x1 = i + 1 == dst.width ? src.width : 2 * i + 2;
+          for (int y = 2 * j; y < y1; ++y)
+            for (int x = 2 * i; x < x1; ++x) {
+              sum += src.rgb[(std::size_t(y) * src.width + x) *
+                                 bytes_per_pixel +
+                             c];
+              ++count;
+            }
+          dst.rgb[(std::size_t(j) * dst.width + i) * bytes_per_pixel + c] =
+              static_cast<std::uint8_t>((sum + count / 2) / count);
+        }
+    return dst;
+  }
+
+  static mip_level make_level(const scanline_image& src, bool tiled,
+                              bool float_storage) {
+    mip_level level{src.width, src.height, {}, {}, {}, {}};
+    level.columns.resize(src.width);
+    level.rows.resize(src.height);
+    std::size_t size;
+    if (tiled) {
+      constexpr auto tile_texels = std::size_t(tile_size) * tile_size;
+      constexpr auto channels = 4;
+      auto tiles_per_row = std::size_t(src.width + tile_size - 1) / tile_size;
+      auto tile_rows = std::size_t(src.height + tile_size - 1) / tile_size;
+      for (int i = 0; i < src.width; ++i)
+        level.columns[i] =
+            (i / tile_size * tile_texels + interleave(i % tile_size)) *
+            channels;
+      for (int j = 0; j < src.height; ++j)
+        level.rows[j] = (j / tile_size * tiles_per_row * tile_texels +
+                         (interleave(j % tile_size) << 1)) *
+                        channels;
+      size = tiles_per_row * tile_rows * tile_texels * channels;
+    } else {
+      for (int i = 0; i < src.width; ++i)
+        level.columns[i] = std::size_t(i) * bytes_per_pixel;
+      for (int j = 0; j < src.height; ++j)
+        level.rows[j] = std::size_t(j) * src.width * bytes_per_pixel;
+      size = src.rgb.size();
+    }
+
+    if (float_storage)
+      level.floats.resize(size);
+    else
+      level.bytes.resize(size);
+    for (int j = 0; j < src.height; ++j)
+      for (int i = 0; i < src.width; ++i)
+        for (int c = 0; c < bytes_per_pixel; ++c) {
+          auto b = src.rgb[(std::size_t(j) * src.width + i) * bytes_per_pixel +
+                           c];
+          auto k = level.columns[i] + level.rows[j] + c;
+          if (float_storage)
+            level.floats[k] = b / 255.0f;
+          else
+            level.bytes[k] = b;
+        }
+    return level;
+  }
+
+  static std::vector<mip_level> build_levels(const std::uint8_t* image,
+                                             int width, int height,
+                                             bool tiled, bool float_storage) {
+    scanline_image current{
+        width, height,
+        {image, image + std::size_t(width) * height * bytes_per_pixel}};
+    std::vector<mip_level> result;
+    result.push_back(make_level(current, tiled, float_storage));
+    while (current.width > 1 || current.height > 1) {
+      current = downsample(current);
+      result.push_back(make_level(current, tiled, float_storage));
+    }
+    return result;
   }
 };
 
@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_TILE_SCHEDULER_HPP
+#define YK_RAYTRACING_TILE_SCHEDULER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace yk {
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1).
+struct tile {
+  std::size_t x0, y0, x1, y1;
+};
+
+namespace detail {
+
+// Spreads the low 16 bits of x so that a zero bit follows each of them.
+constexpr std::uint32_t part1by1(std::uint32_t x) noexcept {
+  x &= 0xffff;
+  x = (x | (x << 8)) & 0x00ff00ff;
+  x = (x | (x << 4)) & 0x0f0f0f0f;
+  x = (x | (x << 2)) & 0x33333333;
+  x = (x | (x << 1)) & 0x55555555;
+  return x;
+}
+
+}  // namespace detail
+
+// Splits a width x height image into square tiles of `tile_size` pixels
+// (smaller at the right and bottom edges), ordered along a Morton curve so
+// that tiles handed out one after another are close on screen.
+inline std::vector<tile> make_tiles(std::size_t width, std::size_t height,
+                                    std::size_t tile_size) {
+  tile_size = std::max<std::size_t>(tile_size, 1);
+  auto cols = (width + tile_size - 1) / tile_size;
+  auto rows = (height + tile_size - 1) / tile_size;
+
+  std::vector<std::pair<std::uint32_t, tile>> keyed;
+  keyed.reserve(cols * rows);
+  for (std::size_t ty = 0; ty < rows; ++ty)
+    for (std::size_t tx = 0; tx < cols; ++tx)
+      keyed.push_back(
+          {detail::part1by1(std::uint32_t(tx)) |
+               (detail::part1by1(std::uint32_t(ty)) << 1),
+           {tx * tile_size, ty * tile_size,
+            std::min(width, (tx + 1) * tile_size),
+            std::min(height, (ty + 1) * tile_size)}});
+  std::sort(keyed.begin(), keyed.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  std::vector<tile> tiles;
+  tiles.reserve(keyed.size());
+  for (const auto& [key, t] : keyed) tiles.push_back(t);
+  return tiles;
+}
+
+// Calls f(tile) for every tile of the image, one tile per task. Idle TBB
+// workers steal whole tiles.
+template <class F>
+void for_each_tile(std::size_t width, std::size_t height,
+                   std::size_t tile_size, F&& f) {
+  auto tiles = make_tiles(width, height, tile_size);
+  parallel_for(0, tiles.size(), [&](std::size_t i) { f(tiles[i]); });
+}
+
+// Calls f(x, y) for every pixel of the image. The pixels of a tile are
+// traced in order on one thread with no per-pixel allocation or task.
+template <class F>
+void for_each_pixel_tiled(std::size_t width, std::size_t height,
+                          std::size_t tile_size, F&& f) {
+  for_each_tile(width, height, tile_size, [&](const tile& t) {
+    for (auto y = t.y0; y < t.y1; ++y)
+      for (auto x = t.x0; x < t.x1; ++x) f(x, y);
+  });
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_TILE_SCHEDULER_HPP
@@ -155,15 +155,21 @@ constexpr vec3<T> refract(const vec3<T>& uv, const vec3<T>& n,
   return r_out_perp + r_out_parallel;
 }
 
+// Uniformly distributed over the unit sphere. (Normalizing vec3::random only
+// reaches the positive octant.)
 template <class T, class Gen>
-constexpr vec3<T> random_in_unit_sphere(Gen& gen) {
-  uniform_real_distribution<T> dist(0, 0.999);
-  return vec3<T>::random(gen).normalized() * dist(gen);
+constexpr vec3<T> random_unit_vector(Gen& gen) {
+  uniform_real_distribution<T> dist(0, 1);
+  auto z = 1 - 2 * dist(gen);
+  auto phi = 2 * T(math::numbers::pi) * dist(gen);
+  auto r = math::sqrt(std::max<T>(0, 1 - z * z));
+  return {r * math::cos(phi), r * math::sin(phi), z};
 }
 
 template <class T, class Gen>
-constexpr vec3<T> random_unit_vector(Gen& gen) {
-  return vec3<T>::random(gen).normalized();
+constexpr vec3<T> random_in_unit_sphere(Gen& gen) {
+  uniform_real_distribution<T> dist(0, 0.999);
+  return random_unit_vector<T>(gen) * dist(gen);
 }
 
 template <class T, class Gen>
@@ -0,0 +1,182 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_WAVEFRONT_HPP
+#define YK_RAYTRACING_WAVEFRONT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "color.hpp"
+#include "custom.hpp"
+#include "hit_record.hpp"
+#include "hittable.hpp"
+#include "integrator.hpp"
+#include "light_list.hpp"
+#include "material_table.hpp"
+#include "parallel.hpp"
+#include "progressive.hpp"
+#include "ray.hpp"
+#include "sampler.hpp"
+
+namespace yk {
+
+// State of every path in flight, one array per field. Paths are addressed by
+// slot; the kernels below work on lists of slots.
+template <class T>
+struct path_queue {
+  std::vector<ray<T>> rays;
+  std::vector<color<T>> throughput;
+  std::vector<color<T>> radiance;
+  std::vector<unsigned int> depth;
+  std::vector<T> pdf;
+  std::vector<philox_sampler> samplers;
+  std::vector<hit_record<T>> hits;
+
+  void resize(std::size_t n) {
+    rays.resize(n);
+    throughput.resize(n);
+    radiance.resize(n);
+    depth.resize(n);
+    pdf.resize(n);
+    samplers.resize(n);
+    hits.resize(n);
+  }
+
+  path_state<T> load(std::uint32_t slot) const noexcept {
+    return {rays[slot], throughput[slot], radiance[slot], depth[slot],
+            pdf[slot]};
+  }
+
+  void store(std::uint32_t slot, const path_state<T>& path) noexcept {
+    rays[slot] = path.r;
+    throughput[slot] = path.throughput;
+    radiance[slot] = path.radiance;
+    depth[slot] = path.depth;
+    pdf[slot] = path.pdf;
+  }
+};
+
+// Stream path tracer. Instead of following one path to the end, every bounce
+// of a whole wave of paths is processed kernel by kernel: all active paths
+// are intersected, the hits are binned by material alternative, and each bin
+// is shaded in one loop that calls that material's scatter() directly.
+//
+// Samples [first_sample, first_sample + spp) of every pixel are traced in
+// waves of at most `wave_size` paths (at least one): a few samples of every
+// pixel, or one sample of a range of pixels. Path (pixel, sample) draws from
+// the same philox_sampler stream as in the per-pixel renderer and every
+// pixel gets its samples in the same order, so the result is identical.
+//
+// `ray_gen(x, y, sampler)` returns the camera ray of one sample, and
+// `accumulate(pixel, radiance)` receives every finished sample, sample by
+// sample for each pixel (pixel = y * width + x). No further wave is started
+// once stop_requested is set.
+template <class T, class RayGen, class Accumulate>
+void render_wavefront(std::size_t width, std::size_t height,
+                      std::uint32_t first_sample, std::uint32_t spp,
+                      std::uint64_t seed, RayGen&& ray_gen,
+                      Accumulate&& accumulate, const color<T>& background,
+                      const hittable<T>& world,
+                      const material_table<T>& materials,
+                      const light_list<T>& lights, unsigned int max_depth,
+                      std::size_t wave_size) {
+  constexpr auto alternatives = std::variant_size_v<material<T>>;
+
+  auto pixels = width * height;
+  if (pixels == 0 || spp == 0) return;
+
+  auto samples_per_wave = std::clamp<std::size_t>(
+      wave_size / pixels, 1, static_cast<std::size_t>(spp));
+  auto pixels_per_wave =
+      std::clamp<std::size_t>(wave_size / samples_per_wave, 1, pixels);
+  path_queue<T> queue;
+  queue.resize(pixels_per_wave * samples_per_wave);
+
+  std::vector<std::uint32_t> active, next;
+  std::vector<std::uint8_t> hit;
+  std::array<std::vector<std::uint32_t>, alternatives> bins;
+
+  for (std::size_t first = first_sample; first < first_sample + spp;
+       first += samples_per_wave) {
+    for (std::size_t first_pixel = 0; first_pixel < pixels;
+         first_pixel += pixels_per_wave) {
+      if (stop_requested) return;
+      auto samples =
+          std::min<std::size_t>(samples_per_wave, first_sample + spp - first);
+      auto wave_pixels = std::min(pixels_per_wave, pixels - first_pixel);
+      auto paths = wave_pixels * samples;
+
+      // Camera rays. Slot = (pixel - first_pixel) * samples + sample within
+      // the wave.
+      parallel_for(0, paths, [&](std::size_t slot) {
+        auto pixel = first_pixel + slot / samples;
+        auto& sampler = queue.samplers[slot];
+        sampler = philox_sampler(seed, pixel, first + slot % samples);
+        queue.store(static_cast<std::uint32_t>(slot),
+                    {ray_gen(pixel % width, pixel / width, sampler)});
+      });
+      active.resize(paths);
+      for (std::size_t i = 0; i < paths; ++i)
+        active[i] = static_cast<std::uint32_t>(i);
+      hit.assign(paths, 0);
+
+      for (unsigned int bounce = 0; bounce < max_depth && !active.empty();
+           ++bounce) {
+        // Intersect every active path.
+        parallel_for(0, active.size(), [&](std::size_t i) {
+          auto slot = active[i];
+          auto& rec = queue.hits[slot];
+          hit[slot] = custom::hit(world, queue.rays[slot], T(0.001),
+                                  std::numeric_limits<T>::infinity(), rec);
+          if (hit[slot])
+            custom::surface(queue.rays[slot], rec);
+          else
+            queue.radiance[slot] += queue.throughput[slot] * background;
+        });
+
+        // Bin the hits by material alternative.
+        for (auto& bin : bins) bin.clear();
+        for (auto slot : active)
+          if (hit[slot])
+            bins[materials[queue.hits[slot].mat].index()].push_back(slot);
+
+        // Shade each bin with its material type known statically.
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+          (
+              [&] {
+                const auto& bin = bins[I];
+                parallel_for(0, bin.size(), [&](std::size_t i) {
+                  auto slot = bin[i];
+                  const auto& rec = queue.hits[slot];
+                  auto path = queue.load(slot);
+                  hit[slot] = shade(path, rec, std::get<I>(materials[rec.mat]),
+                                    world, materials, lights,
+                                    queue.samplers[slot]);
+                  queue.store(slot, path);
+                });
+              }(),
+              ...);
+        }(std::make_index_sequence<alternatives>{});
+
+        next.clear();
+        for (auto slot : active)
+          if (hit[slot]) next.push_back(slot);
+        active.swap(next);
+      }
+
+      for (std::size_t i = 0; i < wave_pixels; ++i)
+        for (std::size_t s = 0; s < samples; ++s)
+          accumulate(first_pixel + i, queue.radiance[i * samples + s]);
+    }
+  }
+}
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_WAVEFRONT_HPP
@@ -0,0 +1,348 @@
+#pragma once
+
+#ifndef YK_RAYTRACING_WIDE_BVH_HPP
+#define YK_RAYTRACING_WIDE_BVH_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "aabb.hpp"
+#include "custom.hpp"
+#include "hit_record.hpp"
+#include "hittable.hpp"
+#include "linear_bvh.hpp"
+#include "parallel.hpp"
+#include "ray.hpp"
+#include "simd.hpp"
+
+namespace yk {
+
+// Node of wide_bvh holding the boxes of up to Width children in SoA form.
+// Unused lanes carry an empty (inverted) box so they never report a hit.
+template <std::size_t Width>
+struct alignas(64) wide_bvh_node {
+  std::array<float, Width> min_x, min_y, min_z;
+  std::array<float, Width> max_x, max_y, max_z;
+  std::array<std::uint32_t, Width> child;  // node index or first primitive
+  std::array<std::uint16_t, Width> count;  // primitives in a leaf, else 0
+};
+
+namespace detail {
+
+// Sorts the first `n` elements of `a` by `less`. Nodes have a handful of
+// children to order, which insertion sort over the fixed-size array handles
+// without std::sort's general machinery (and its -Warray-bounds false
+// positives on small arrays).
+template <class U, std::size_t Size, class Less>
+constexpr void insertion_sort(std::array<U, Size>& a, std::size_t n,
+                              Less less) noexcept {
+  for (std::size_t i = 1; i < n && i < Size; ++i) {
+    auto x = a[i];
+    auto j = i;
+    for (; j > 0 && less(x, a[j - 1]); --j) a[j] = a[j - 1];
+    a[j] = x;
+  }
+}
+
+}  // namespace detail
+
+// BVH with Width children per node, collapsed from a binary linear_bvh. One
+// ray is tested against all child boxes of a node at once with SIMD, and the
+// children that are hit are visited front to back. linear_bvh remains the
+// scalar path.
+template <class T, std::size_t Width>
+struct wide_bvh {
+  static_assert(Width == 4 || Width == 8, "wide_bvh supports 4 or 8 lanes");
+
+  static constexpr std::size_t stack_size = 64 * Width;
+  // Nodes this close to the root refit their children in parallel.
+  static constexpr std::size_t parallel_refit_depth = 2;
+
+  std::vector<wide_bvh_node<Width>> nodes;
+  std::vector<hittable<T>> primitives;
+  // Index of every primitive in the hittable_list it was built from.
+  std::vector<std::uint32_t> order;
+
+  constexpr wide_bvh() noexcept = default;
+
+  template <class Gen>
+  constexpr wide_bvh(hittable_list<T>&& list, T time0, T time1, Gen& gen,
+                     bvh_split split = bvh_split::sah)
+      : wide_bvh(linear_bvh<T>(std::move(list), time0, time1, gen, split)) {}
+
+  constexpr wide_bvh(linear_bvh<T>&& bvh)
+      : primitives(std::move(bvh.primitives)), order(std::move(bvh.order)) {
+    if (!bvh.nodes.empty()) collapse(bvh.nodes, 0);
+  }
+
+  bool hit(const ray<T>& r, T t_min, T t_max,
+           hit_record<T>& rec) const noexcept {
+    if (nodes.empty()) return false;
+
+    using P = simd::native_pack<T, Width>;
+    constexpr auto N = P::width;
+
+    vec3<T> inv_dir{1 / r.direction.x, 1 / r.direction.y, 1 / r.direction.z};
+    // Pick the near and far slab of every axis once from the ray direction.
+    auto near_x = inv_dir.x < 0 ? &node_type::max_x : &node_type::min_x;
+    auto far_x = inv_dir.x < 0 ? &node_type::min_x : &node_type::max_x;
+    auto near_y = inv_dir.y < 0 ? &node_type::max_y : &node_type::min_y;
+    auto far_y = inv_dir.y < 0 ? &node_type::min_y : &node_type::max_y;
+    auto near_z = inv_dir.z < 0 ? &node_type::max_z : &node_type::min_z;
+    auto far_z = inv_dir.z < 0 ? &node_type::min_z : &node_type::max_z;
+    auto ox = P::broadcast(r.origin.x);
+    auto oy = P::broadcast(r.origin.y);
+    auto oz = P::broadcast(r.origin.z);
+    auto ix = P::broadcast(inv_dir.x);
+    auto iy = P::broadcast(inv_dir.y);
+    auto iz = P::broadcast(inv_dir.z);
+
+    struct entry {
+      T t_near;
+      std::uint32_t child;
+      std::uint16_t count;
+    };
+    std::array<entry, stack_size> stack;
+    std::size_t top = 0;
+    stack[top++] = {t_min, 0, 0};
+    bool hit_anything = false;
+
+    while (top) {
+      auto [t_near, child, count] = stack[--top];
+      if (t_near > t_max) continue;
+
+      if (count) {
+        for (auto i = child; i < child + count; ++i) {
+          if (custom::hit(primitives[i], r, t_min, t_max, rec)) {
+            hit_anything = true;
+            t_max = rec.t;
+          }
+        }
+        continue;
+      }
+
+      const auto& node = nodes[child];
+      std::array<T, Width> lane_near;
+      unsigned mask = 0;
+      auto lo = P::broadcast(t_min);
+      auto hi = P::broadcast(t_max);
+      for (std::size_t c = 0; c < Width; c += N) {
+        auto t0 = max(max((P::load(&(node.*near_x)[c]) - ox) * ix,
+                          (P::load(&(node.*near_y)[c]) - oy) * iy),
+                      max((P::load(&(node.*near_z)[c]) - oz) * iz, lo));
+        auto t1 = min(min((P::load(&(node.*far_x)[c]) - ox) * ix,
+                          (P::load(&(node.*far_y)[c]) - oy) * iy),
+                      min((P::load(&(node.*far_z)[c]) - oz) * iz, hi));
+        t0.store(&lane_near[c]);
+        mask |= less_equal(t0, t1) << c;
+      }
+
+      // Push the children that were hit farthest first, so that the nearest
+      // one is popped next.
+      std::array<std::size_t, Width> order;
+      std::size_t hits = 0;
+      for (std::size_t i = 0; i < Width; ++i)
+        if (mask >> i & 1) order[hits++] = i;
+      detail::insertion_sort(order, hits, [&](auto a, auto b) {
+        return lane_near[a] > lane_near[b];
+      });
+      for (std::size_t k = 0; k < hits; ++k) {
+        auto i = order[k];
+        stack[top++] = {lane_near[i], node.child[i], node.count[i]};
+      }
+    }
+
+    return hit_anything;
+  }
+
+  // Same traversal as hit() without ordering the children or tracking the
+  // closest hit: returns at the first primitive crossed.
+  bool occluded(const ray<T>& r, T t_min, T t_max) const noexcept {
+    if (nodes.empty()) return false;
+
+    using P = simd::native_pack<T, Width>;
+    constexpr auto N = P::width;
+
+    vec3<T> inv_dir{1 / r.direction.x, 1 / r.direction.y, 1 / r.direction.z};
+    auto near_x = inv_dir.x < 0 ? &node_type::max_x : &node_type::min_x;
+    auto far_x = inv_dir.x < 0 ? &node_type::min_x : &node_type::max_x;
+    auto near_y = inv_dir.y < 0 ? &node_type::max_y : &node_type::min_y;
+    auto far_y = inv_dir.y < 0 ? &node_type::min_y : &node_type::max_y;
+    auto near_z = inv_dir.z < 0 ? &node_type::max_z : &node_type::min_z;
+    auto far_z = inv_dir.z < 0 ? &node_type::min_z : &node_type::max_z;
+    auto ox = P::broadcast(r.origin.x);
+    auto oy = P::broadcast(r.origin.y);
+    auto oz = P::broadcast(r.origin.z);
+    auto ix = P::broadcast(inv_dir.x);
+    auto iy = P::broadcast(inv_dir.y);
+    auto iz = P::broadcast(inv_dir.z);
+    auto lo = P::broadcast(t_min);
+    auto hi = P::broadcast(t_max);
+
+    struct entry {
+      std::uint32_t child;
+      std::uint16_t count;
+    };
+    std::array<entry, stack_size> stack;
+    std::size_t top = 0;
+    stack[top++] = {0, 0};
+
+    while (top) {
+      auto [child, count] = stack[--top];
+      if (count) {
+        for (auto i = child; i < child + count; ++i)
+          if (custom::occluded(primitives[i], r, t_min, t_max)) return true;
+        continue;
+      }
+
+      const auto& node = nodes[child];
+      unsigned mask = 0;
+      for (std::size_t c = 0; c < Width; c += N) {
+        auto t0 = max(max((P::load(&(node.*near_x)[c]) - ox) * ix,
+                          (P::load(&(node.*near_y)[c]) - oy) * iy),
+                      max((P::load(&(node.*near_z)[c]) - oz) * iz, lo));
+        auto t1 = min(min((P::load(&(node.*far_x)[c]) - ox) * ix,
+                          (P::load(&(node.*far_y)[c]) - oy) * iy),
+                      min((P::load(&(node.*far_z)[c]) - oz) * iz, hi));
+        mask |= less_equal(t0, t1) << c;
+      }
+      for (std::size_t i = 0; i < Width; ++i)
+        if (mask >> i & 1) stack[top++] = {node.child[i], node.count[i]};
+    }
+
+    return false;
+  }
+
+  constexpr bool bounding_box(T time0, T time1,
+                              aabb<T>& output_box) const noexcept {
+    if (nodes.empty()) return false;
+    const auto& root = nodes.front();
+    output_box = {
+        {*std::min_element(root.min_x.begin(), root.min_x.end()),
+         *std::min_element(root.min_y.begin(), root.min_y.end()),
+         *std::min_element(root.min_z.begin(), root.min_z.end())},
+        {*std::max_element(root.max_x.begin(), root.max_x.end()),
+         *std::max_element(root.max_y.begin(), root.max_y.end()),
+         *std::max_element(root.max_z.begin(), root.max_z.end())},
+    };
+    return true;
+  }
+
+  // Recomputes every lane box bottom-up from the current primitive bounds
+  // over [time0, time1] while keeping the topology.
+  void refit(T time0, T time1) {
+    if (!nodes.empty()) refit(0, time0, time1, 0);
+  }
+
+ private:
+  using node_type = wide_bvh_node<Width>;
+
+  aabb<T> refit(std::uint32_t index, T time0, T time1, std::size_t depth) {
+    auto& node = nodes[index];
+    std::array<aabb<T>, Width> boxes{};
+    auto refit_lane = [&](std::size_t i) {
+      if (node.count[i]) {
+        for (auto p = node.child[i]; p < node.child[i] + node.count[i]; ++p) {
+          aabb<T> b{};
+          if (!custom::bounding_box(primitives[p], time0, time1, b))
+            std::cerr << "No bounding box in wide_bvh::refit.\n";
+          boxes[i] = p == node.child[i] ? b : surrounding_box(boxes[i], b);
+        }
+      } else if (node.min_x[i] <= node.max_x[i])
+        boxes[i] = refit(node.child[i], time0, time1, depth + 1);
+    };
+    if (depth < parallel_refit_depth)
+      parallel_for(0, Width, refit_lane);
+    else
+      for (std::size_t i = 0; i < Width; ++i) refit_lane(i);
+
+    std::optional<aabb<T>> result;
+    for (std::size_t i = 0; i < Width; ++i) {
+      if (!(node.min_x[i] <= node.max_x[i])) continue;  // unused lane
+      auto b = detail::to_float_box(boxes[i]);
+      node.min_x[i] = b.minimum.x;
+      node.min_y[i] = b.minimum.y;
+      node.min_z[i] = b.minimum.z;
+      node.max_x[i] = b.maximum.x;
+      node.max_y[i] = b.maximum.y;
+      node.max_z[i] = b.maximum.z;
+      result = result ? surrounding_box(*result, boxes[i]) : boxes[i];
+    }
+    return result.value_or(aabb<T>{});
+  }
+
+  // Turns the subtree of binary node `index` into one wide node, opening the
+  // largest interior child until Width children are gathered, and recurses.
+  constexpr std::uint32_t collapse(const std::vector<linear_bvh_node>& binary,
+                                   std::uint32_t index) {
+    std::array<std::uint32_t, Width> children;
+    std::size_t n = 0;
+    if (binary[index].count)
+      children[n++] = index;
+    else {
+      children[n++] = index + 1;
+      children[n++] = binary[index].offset;
+    }
+
+    while (n < Width) {
+      auto best = Width;
+      auto best_area = -std::numeric_limits<float>::infinity();
+      for (std::size_t i = 0; i < n; ++i) {
+        const auto& b = binary[children[i]];
+        if (b.count == 0 && b.box.surface_area() > best_area) {
+          best = i;
+          best_area = b.box.surface_area();
+        }
+      }
+      if (best == Width) break;
+      auto opened = children[best];
+      children[best] = opened + 1;
+      children[n++] = binary[opened].offset;
+    }
+
+    auto result = static_cast<std::uint32_t>(nodes.size());
+    nodes.emplace_back();
+    auto& empty = nodes.back();
+    empty.min_x.fill(std::numeric_limits<float>::infinity());
+    empty.min_y.fill(std::numeric_limits<float>::infinity());
+    empty.min_z.fill(std::numeric_limits<float>::infinity());
+    empty.max_x.fill(-std::numeric_limits<float>::infinity());
+    empty.max_y.fill(-std::numeric_limits<float>::infinity());
+    empty.max_z.fill(-std::numeric_limits<float>::infinity());
+    empty.child.fill(0);
+    empty.count.fill(0);
+
+    for (std::size_t i = 0; i < n; ++i) {
+      const auto& b = binary[children[i]];
+      // collapse() grows `nodes`, so index into it again for every lane.
+      auto child = b.count ? b.offset : collapse(binary, children[i]);
+      auto& node = nodes[result];
+      node.min_x[i] = b.box.minimum.x;
+      node.min_y[i] = b.box.minimum.y;
+      node.min_z[i] = b.box.minimum.z;
+      node.max_x[i] = b.box.maximum.x;
+      node.max_y[i] = b.box.maximum.y;
+      node.max_z[i] = b.box.maximum.z;
+      node.child[i] = child;
+      node.count[i] = b.count;
+    }
+    return result;
+  }
+};
+
+template <class T>
+using bvh4 = wide_bvh<T, 4>;
+
+template <class T>
+using bvh8 = wide_bvh<T, 8>;
+
+}  // namespace yk
+
+#endif  // !YK_RAYTRACING_WIDE_BVH_HPP